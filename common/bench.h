@@ -0,0 +1,207 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define BENCH_INITIAL_CAPACITY 64
+
+struct s_bench_samples
+{
+        double *values;
+        int nb_values;
+        int capacity;
+};
+
+struct s_bench_stats
+{
+        int nb_samples;
+        double min;
+        double median;
+        double mean;
+        double p95;
+        double stddev;
+};
+
+static inline double bench_elapsed(const struct timespec *p_start, const struct timespec *p_end)
+{
+        return (p_end->tv_sec - p_start->tv_sec) + 1.0e-9 * (p_end->tv_nsec - p_start->tv_nsec);
+}
+
+static inline void bench_samples_init(struct s_bench_samples *p_samples)
+{
+        p_samples->capacity = BENCH_INITIAL_CAPACITY;
+        p_samples->nb_values = 0;
+        p_samples->values = (double *)malloc(p_samples->capacity * sizeof(*p_samples->values));
+        if (p_samples->values == NULL)
+        {
+                fprintf(stderr, "%s:%d - %s\n", __FILE__, __LINE__, "memory allocation failed");
+                exit(EXIT_FAILURE);
+        }
+}
+
+static inline void bench_samples_add(struct s_bench_samples *p_samples, double value)
+{
+        if (p_samples->nb_values == p_samples->capacity)
+        {
+                p_samples->capacity *= 2;
+                double *values = (double *)realloc(p_samples->values, p_samples->capacity * sizeof(*values));
+                if (values == NULL)
+                {
+                        fprintf(stderr, "%s:%d - %s\n", __FILE__, __LINE__, "memory allocation failed");
+                        exit(EXIT_FAILURE);
+                }
+                p_samples->values = values;
+        }
+        p_samples->values[p_samples->nb_values++] = value;
+}
+
+static inline void bench_samples_delete(struct s_bench_samples *p_samples)
+{
+        free(p_samples->values);
+        p_samples->values = NULL;
+        p_samples->nb_values = 0;
+        p_samples->capacity = 0;
+}
+
+static inline int bench_compare_double(const void *p_a, const void *p_b)
+{
+        double a = *(const double *)p_a;
+        double b = *(const double *)p_b;
+        return (a > b) - (a < b);
+}
+
+static inline void bench_compute_stats(const struct s_bench_samples *p_samples, struct s_bench_stats *p_stats)
+{
+        const int n = p_samples->nb_values;
+        memset(p_stats, 0, sizeof(*p_stats));
+        p_stats->nb_samples = n;
+        if (n == 0)
+        {
+                return;
+        }
+
+        double *sorted = (double *)malloc(n * sizeof(*sorted));
+        if (sorted == NULL)
+        {
+                fprintf(stderr, "%s:%d - %s\n", __FILE__, __LINE__, "memory allocation failed");
+                exit(EXIT_FAILURE);
+        }
+        memcpy(sorted, p_samples->values, n * sizeof(*sorted));
+        qsort(sorted, n, sizeof(*sorted), bench_compare_double);
+
+        double sum = 0.0;
+        int i;
+        for (i = 0; i < n; i++)
+        {
+                sum += sorted[i];
+        }
+        p_stats->mean = sum / n;
+
+        double sum_sq = 0.0;
+        for (i = 0; i < n; i++)
+        {
+                double d = sorted[i] - p_stats->mean;
+                sum_sq += d * d;
+        }
+        p_stats->stddev = (n > 1) ? sqrt(sum_sq / (n - 1)) : 0.0;
+
+        p_stats->min = sorted[0];
+        p_stats->median = (n % 2) ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+
+        /* nearest-rank percentile */
+        int p95_rank = (int)ceil(0.95 * n) - 1;
+        p_stats->p95 = sorted[p95_rank < 0 ? 0 : p95_rank];
+
+        free(sorted);
+}
+
+static inline void bench_print_stats_csv_header(void)
+{
+        printf("nb_samples,min,median,mean,p95,stddev");
+}
+
+static inline void bench_print_stats_csv(const struct s_bench_stats *p_stats)
+{
+        printf("%d,%le,%le,%le,%le,%le", p_stats->nb_samples, p_stats->min, p_stats->median,
+               p_stats->mean, p_stats->p95, p_stats->stddev);
+}
+
+/* work_units and bytes are per sample; throughput is derived from the median */
+static inline void bench_print_throughput_csv(double work_units, double bytes, const struct s_bench_stats *p_stats)
+{
+        double seconds = p_stats->median;
+        if (seconds > 0.0)
+        {
+                printf("%le,%le", work_units / seconds, 1.0e-9 * bytes / seconds);
+        }
+        else
+        {
+                printf(",");
+        }
+}
+
+static inline void bench_pin_to_nth_cpu(const cpu_set_t *p_allowed, int rank)
+{
+        int nb_cpus = CPU_COUNT(p_allowed);
+        if (nb_cpus == 0)
+        {
+                return;
+        }
+
+        int target = rank % nb_cpus;
+        int cpu;
+        for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+                if (CPU_ISSET(cpu, p_allowed))
+                {
+                        if (target == 0)
+                        {
+                                break;
+                        }
+                        target--;
+                }
+        }
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        {
+                perror("sched_setaffinity");
+        }
+}
+
+/*
+ * Pins every thread of the (OpenMP) team to its own CPU, round-robin over the
+ * CPUs the process is allowed to run on. The mask is read once beforehand,
+ * since threads spawned later inherit the affinity of the master thread.
+ */
+static inline void bench_pin_threads(void)
+{
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        {
+                perror("sched_getaffinity");
+                return;
+        }
+
+#ifdef _OPENMP
+#pragma omp parallel
+        {
+                bench_pin_to_nth_cpu(&allowed, omp_get_thread_num());
+        }
+#else
+        bench_pin_to_nth_cpu(&allowed, 0);
+#endif
+}
+
+#endif
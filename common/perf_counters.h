@@ -0,0 +1,301 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+enum e_perf_counter
+{
+        perf_counter_cycles = 0,
+        perf_counter_instructions,
+        perf_counter_l1d_misses,
+        perf_counter_llc_misses,
+        perf_counter_branch_misses,
+        NB_PERF_COUNTERS
+};
+
+/*
+ * One perf_event group per thread of the OpenMP team, opened disabled and
+ * only enabled between perf_counters_enable() and perf_counters_disable(), so
+ * the counts cover the timed region only. Counters the kernel or the hardware
+ * refuse are left out of the group and reported as empty CSV fields.
+ */
+struct s_perf_counters
+{
+        int nb_threads;
+        int *fds;
+        int *leaders;
+        int available[NB_PERF_COUNTERS];
+        double last[NB_PERF_COUNTERS];
+        double total[NB_PERF_COUNTERS];
+        int nb_samples;
+        int open_errno;
+};
+
+static inline void perf_counter_attr(enum e_perf_counter counter, struct perf_event_attr *p_attr)
+{
+        memset(p_attr, 0, sizeof(*p_attr));
+        p_attr->size = sizeof(*p_attr);
+        p_attr->exclude_kernel = 1;
+        p_attr->exclude_hv = 1;
+        p_attr->read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        switch (counter)
+        {
+        case perf_counter_cycles:
+                p_attr->type = PERF_TYPE_HARDWARE;
+                p_attr->config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+
+        case perf_counter_instructions:
+                p_attr->type = PERF_TYPE_HARDWARE;
+                p_attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+
+        case perf_counter_l1d_misses:
+                p_attr->type = PERF_TYPE_HW_CACHE;
+                p_attr->config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+
+        case perf_counter_llc_misses:
+                p_attr->type = PERF_TYPE_HARDWARE;
+                p_attr->config = PERF_COUNT_HW_CACHE_MISSES;
+                break;
+
+        case perf_counter_branch_misses:
+                p_attr->type = PERF_TYPE_HARDWARE;
+                p_attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+                break;
+
+        default:
+                break;
+        }
+}
+
+static inline int perf_counters_syscall_open(struct perf_event_attr *p_attr, int group_fd)
+{
+        return (int)syscall(SYS_perf_event_open, p_attr, 0, -1, group_fd, 0);
+}
+
+static inline void perf_counters_open_thread(struct s_perf_counters *p_counters, int thread_id)
+{
+        int *fds = p_counters->fds + thread_id * NB_PERF_COUNTERS;
+        int leader = -1;
+        int c;
+        for (c = 0; c < NB_PERF_COUNTERS; c++)
+        {
+                struct perf_event_attr attr;
+                perf_counter_attr((enum e_perf_counter)c, &attr);
+                attr.disabled = (leader == -1);
+                fds[c] = perf_counters_syscall_open(&attr, leader);
+                if (fds[c] >= 0 && leader == -1)
+                {
+                        leader = fds[c];
+                }
+        }
+        p_counters->leaders[thread_id] = leader;
+        if (leader < 0 && thread_id == 0)
+        {
+                p_counters->open_errno = errno;
+        }
+}
+
+static inline void perf_counters_init(struct s_perf_counters *p_counters)
+{
+        memset(p_counters, 0, sizeof(*p_counters));
+
+        int nb_threads = 1;
+#ifdef _OPENMP
+#pragma omp parallel
+        {
+#pragma omp master
+                {
+                        nb_threads = omp_get_num_threads();
+                }
+        }
+#endif
+        p_counters->nb_threads = nb_threads;
+        p_counters->fds = (int *)malloc(nb_threads * NB_PERF_COUNTERS * sizeof(*p_counters->fds));
+        p_counters->leaders = (int *)malloc(nb_threads * sizeof(*p_counters->leaders));
+        if (p_counters->fds == NULL || p_counters->leaders == NULL)
+        {
+                fprintf(stderr, "%s:%d - %s\n", __FILE__, __LINE__, "memory allocation failed");
+                exit(EXIT_FAILURE);
+        }
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nb_threads)
+        {
+                perf_counters_open_thread(p_counters, omp_get_thread_num());
+        }
+#else
+        perf_counters_open_thread(p_counters, 0);
+#endif
+
+        /* a counter is reported only if every thread managed to open it */
+        int c;
+        for (c = 0; c < NB_PERF_COUNTERS; c++)
+        {
+                int t;
+                p_counters->available[c] = 1;
+                for (t = 0; t < nb_threads; t++)
+                {
+                        if (p_counters->fds[t * NB_PERF_COUNTERS + c] < 0)
+                        {
+                                p_counters->available[c] = 0;
+                        }
+                }
+        }
+
+        if (p_counters->leaders[0] < 0)
+        {
+                fprintf(stderr, "warning: hardware performance counters unavailable (%s), check /proc/sys/kernel/perf_event_paranoid\n",
+                        strerror(p_counters->open_errno));
+        }
+}
+
+static inline void perf_counters_ioctl(struct s_perf_counters *p_counters, unsigned long request)
+{
+        int t;
+        for (t = 0; t < p_counters->nb_threads; t++)
+        {
+                int leader = p_counters->leaders[t];
+                if (leader >= 0)
+                {
+                        ioctl(leader, request, PERF_IOC_FLAG_GROUP);
+                }
+        }
+}
+
+static inline void perf_counters_reset(struct s_perf_counters *p_counters)
+{
+        perf_counters_ioctl(p_counters, PERF_EVENT_IOC_RESET);
+}
+
+static inline void perf_counters_enable(struct s_perf_counters *p_counters)
+{
+        perf_counters_ioctl(p_counters, PERF_EVENT_IOC_ENABLE);
+}
+
+static inline void perf_counters_disable(struct s_perf_counters *p_counters)
+{
+        perf_counters_ioctl(p_counters, PERF_EVENT_IOC_DISABLE);
+}
+
+/* reads the counts accumulated since the last reset and adds them to the totals */
+static inline void perf_counters_collect(struct s_perf_counters *p_counters)
+{
+        int t;
+        memset(p_counters->last, 0, sizeof(p_counters->last));
+        for (t = 0; t < p_counters->nb_threads; t++)
+        {
+                int leader = p_counters->leaders[t];
+                if (leader < 0)
+                {
+                        continue;
+                }
+
+                /* group layout: nr, time_enabled, time_running, value[nr] */
+                uint64_t buffer[3 + NB_PERF_COUNTERS];
+                if (read(leader, buffer, sizeof(buffer)) < (ssize_t)(3 * sizeof(uint64_t)))
+                {
+                        continue;
+                }
+                uint64_t nr = buffer[0];
+                double scale = (buffer[2] > 0) ? (double)buffer[1] / (double)buffer[2] : 0.0;
+
+                const int *fds = p_counters->fds + t * NB_PERF_COUNTERS;
+                uint64_t k = 0;
+                int c;
+                for (c = 0; c < NB_PERF_COUNTERS && k < nr; c++)
+                {
+                        if (fds[c] >= 0)
+                        {
+                                p_counters->last[c] += scale * (double)buffer[3 + k];
+                                k++;
+                        }
+                }
+        }
+
+        int c;
+        for (c = 0; c < NB_PERF_COUNTERS; c++)
+        {
+                p_counters->total[c] += p_counters->last[c];
+        }
+        p_counters->nb_samples++;
+}
+
+static inline void perf_counters_delete(struct s_perf_counters *p_counters)
+{
+        int i;
+        for (i = 0; i < p_counters->nb_threads * NB_PERF_COUNTERS; i++)
+        {
+                if (p_counters->fds[i] >= 0)
+                {
+                        close(p_counters->fds[i]);
+                }
+        }
+        free(p_counters->fds);
+        free(p_counters->leaders);
+        p_counters->fds = NULL;
+        p_counters->leaders = NULL;
+}
+
+static inline void perf_counters_print_csv_header(void)
+{
+        printf("cycles,instructions,ipc,l1d_misses,llc_misses,branch_misses");
+}
+
+static inline void perf_counters_print_values_csv(const struct s_perf_counters *p_counters, const double *values)
+{
+        int c;
+        for (c = 0; c < NB_PERF_COUNTERS; c++)
+        {
+                if (c > 0)
+                {
+                        printf(",");
+                }
+                if (p_counters->available[c])
+                {
+                        printf("%.0lf", values[c]);
+                }
+
+                if (c == perf_counter_instructions)
+                {
+                        printf(",");
+                        if (p_counters->available[perf_counter_cycles] && p_counters->available[perf_counter_instructions] && values[perf_counter_cycles] > 0.0)
+                        {
+                                printf("%.3lf", values[perf_counter_instructions] / values[perf_counter_cycles]);
+                        }
+                }
+        }
+}
+
+static inline void perf_counters_print_last_csv(const struct s_perf_counters *p_counters)
+{
+        perf_counters_print_values_csv(p_counters, p_counters->last);
+}
+
+static inline void perf_counters_print_mean_csv(const struct s_perf_counters *p_counters)
+{
+        double mean[NB_PERF_COUNTERS];
+        int c;
+        for (c = 0; c < NB_PERF_COUNTERS; c++)
+        {
+                mean[c] = (p_counters->nb_samples > 0) ? p_counters->total[c] / p_counters->nb_samples : 0.0;
+        }
+        perf_counters_print_values_csv(p_counters, mean);
+}
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef PHASE_TIMER_H
+#define PHASE_TIMER_H
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "perf_counters.h"
+
+enum e_phase
+{
+        phase_alloc = 0,
+        phase_init,
+        phase_kernel,
+        phase_output,
+        phase_check,
+        NB_PHASES
+};
+
+/*
+ * Accumulates wall-clock time per phase. The kernel phase is always timed,
+ * since it is what the timing column reports; the other phases only cost a
+ * branch unless phase timing is enabled. When hardware counters are attached,
+ * they are enabled during the kernel phase only.
+ */
+struct s_phase_timer
+{
+        unsigned int enabled_mask;
+        struct s_perf_counters *p_perf_counters;
+        struct timespec start[NB_PHASES];
+        double elapsed[NB_PHASES];
+        double total[NB_PHASES];
+        int nb_samples;
+};
+
+static inline void phase_timer_init(struct s_phase_timer *p_timer, int enable_all_phases, struct s_perf_counters *p_perf_counters)
+{
+        memset(p_timer, 0, sizeof(*p_timer));
+        p_timer->enabled_mask = enable_all_phases ? ((1u << NB_PHASES) - 1) : (1u << phase_kernel);
+        p_timer->p_perf_counters = p_perf_counters;
+}
+
+static inline void phase_timer_begin(struct s_phase_timer *p_timer, enum e_phase phase)
+{
+        if (p_timer->enabled_mask & (1u << phase))
+        {
+                if (phase == phase_kernel && p_timer->p_perf_counters != NULL)
+                {
+                        perf_counters_enable(p_timer->p_perf_counters);
+                }
+                clock_gettime(CLOCK_MONOTONIC, &p_timer->start[phase]);
+        }
+}
+
+static inline void phase_timer_end(struct s_phase_timer *p_timer, enum e_phase phase)
+{
+        if (p_timer->enabled_mask & (1u << phase))
+        {
+                struct timespec end;
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                p_timer->elapsed[phase] += (end.tv_sec - p_timer->start[phase].tv_sec) + 1.0e-9 * (end.tv_nsec - p_timer->start[phase].tv_nsec);
+                if (phase == phase_kernel && p_timer->p_perf_counters != NULL)
+                {
+                        perf_counters_disable(p_timer->p_perf_counters);
+                }
+        }
+}
+
+/* accounts for time measured elsewhere, e.g. work shared between several timers */
+static inline void phase_timer_add(struct s_phase_timer *p_timer, enum e_phase phase, double seconds)
+{
+        if (p_timer->enabled_mask & (1u << phase))
+        {
+                p_timer->elapsed[phase] += seconds;
+        }
+}
+
+/* starts a new repeat: one-off allocation time is kept, the other phases restart from zero */
+static inline void phase_timer_reset(struct s_phase_timer *p_timer)
+{
+        int phase;
+        for (phase = 0; phase < NB_PHASES; phase++)
+        {
+                if (phase != phase_alloc)
+                {
+                        p_timer->elapsed[phase] = 0.0;
+                }
+        }
+        if (p_timer->p_perf_counters != NULL)
+        {
+                perf_counters_reset(p_timer->p_perf_counters);
+        }
+}
+
+static inline void phase_timer_collect(struct s_phase_timer *p_timer)
+{
+        int phase;
+        for (phase = 0; phase < NB_PHASES; phase++)
+        {
+                p_timer->total[phase] += p_timer->elapsed[phase];
+        }
+        p_timer->nb_samples++;
+        if (p_timer->p_perf_counters != NULL)
+        {
+                perf_counters_collect(p_timer->p_perf_counters);
+        }
+}
+
+static inline void phase_timer_print_csv_header(void)
+{
+        printf("alloc_time,init_time,kernel_time,output_time,check_time");
+}
+
+static inline void phase_timer_print_csv(const struct s_phase_timer *p_timer)
+{
+        printf("%le,%le,%le,%le,%le", p_timer->elapsed[phase_alloc], p_timer->elapsed[phase_init],
+               p_timer->elapsed[phase_kernel], p_timer->elapsed[phase_output], p_timer->elapsed[phase_check]);
+}
+
+static inline void phase_timer_print_mean_csv(const struct s_phase_timer *p_timer)
+{
+        double mean[NB_PHASES];
+        int phase;
+        for (phase = 0; phase < NB_PHASES; phase++)
+        {
+                mean[phase] = (p_timer->nb_samples > 0) ? p_timer->total[phase] / p_timer->nb_samples : 0.0;
+        }
+        /* allocation happens once per run, not once per repeat */
+        mean[phase_alloc] = p_timer->elapsed[phase_alloc];
+        printf("%le,%le,%le,%le,%le", mean[phase_alloc], mean[phase_init], mean[phase_kernel],
+               mean[phase_output], mean[phase_check]);
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <limits.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,34 +7,154 @@
 #include <time.h>
 #include <unistd.h>
 
-#define ELEMENT_TYPE float
+#include "bench.h"
+#include "perf_counters.h"
+#include "phase_timer.h"
+
+#include "histogram.h"
 
 #define DEFAULT_ARRAY_LEN 10
 #define DEFAULT_NB_BINS 5
 #define DEFAULT_LOWER_BOUND 0.0
 #define DEFAULT_UPPER_BOUND 10.0
+#define DEFAULT_PRECISION 3
+#define DEFAULT_ENGINE "naive"
 #define DEFAULT_NB_REPEAT 10
+#define DEFAULT_NB_WARMUP 0
+#define DEFAULT_MIN_TIME 0.0
+#define DEFAULT_CHUNK_LEN 0
+#define DEFAULT_WINDOW_LEN 0
+#define DEFAULT_BATCH_SIZE 1
+#define DEFAULT_SAMPLE_BITS 12
+
+#define MAX_QUANTILES 16
+
+/* the main spec plus up to MAX_SPECS - 1 extra ones for the multi engines */
+#define MAX_SPECS 16
+
+/* compensated sums of the same weights agree far below this relative error */
+#define CHECK_RELATIVE_TOLERANCE 1e-12
+
+/* double weights span this many orders of magnitude, where plain summation loses bits */
+#define WEIGHT_DECADES 8
 
 #define MAX_DISPLAY_COLUMNS 10
 #define MAX_DISPLAY_ROWS 20
 
+/* count: 64-bit counts, without the 2^31 limit of the int bins */
+enum e_weights
+{
+        weights_none = 0,
+        weights_count,
+        weights_u64,
+        weights_double
+};
+
+static const char *weights_names[] = {"none", "count", "u64", "double"};
+
+/* u8, u16, u32: quantized samples, e.g. from an ADC, read at their own width */
+enum e_input_type
+{
+        input_float = 0,
+        input_u8,
+        input_u16,
+        input_u32
+};
+
+static const char *input_type_names[] = {"float", "u8", "u16", "u32"};
+static const int input_type_bits[] = {8 * sizeof(ELEMENT_TYPE), 8, 16, 32};
+
 struct s_settings
 {
         int array_len;
         int nb_bins;
         double lower_bound;
         double upper_bound;
+        enum e_histogram_scale scale;
+        int precision;
+        /* --2d: (x, y) pairs, nb_bins and the bounds above being the x axis */
+        int enable_2d;
+        int y_nb_bins;
+        double y_lower_bound;
+        double y_upper_bound;
+        struct s_histogram_spec spec;
+        struct s_histogram_2d_spec spec_2d;
+        /* bins of one histogram: nb_bins, or x by y cells with --2d */
+        int nb_cells;
+        enum e_weights weights;
+        enum e_input_type input_type;
+        /* random bits of each integer sample; 0 until parsed, then at most the width of the input type */
+        int sample_bits;
+        struct s_histogram_spec specs[MAX_SPECS];
+        int nb_specs;
+        const struct s_histogram_engine *p_engine;
+        int chunk_len;
+        int window_len;
+        int batch_size;
+        size_t *batch_offsets;
+        double quantiles[MAX_QUANTILES];
+        int nb_quantiles;
         int nb_repeat;
+        int nb_warmup;
+        double min_time;
+        int enable_pinning;
+        int enable_summary;
+        int enable_perf_counters;
+        int enable_phase_timing;
         int enable_output;
         int enable_verbose;
 };
 
-#define PRINT_ERROR(MSG)                                                    \
-        do                                                                  \
-        {                                                                   \
-                fprintf(stderr, "%s:%d - %s\n", __FILE__, __LINE__, (MSG)); \
-                exit(EXIT_FAILURE);                                         \
-        } while (0)
+struct s_engine_run
+{
+        const struct s_histogram_engine *p_engine;
+        struct s_bench_samples samples;
+        struct s_perf_counters perf_counters;
+        struct s_phase_timer phase_timer;
+        struct s_histogram_context *p_context;
+        struct s_histogram_window *p_window;
+        int *extra_histograms[MAX_SPECS];
+        double quantiles[MAX_QUANTILES];
+        double measured_time;
+        int check_status;
+};
+
+/*
+ * samples shared by all engines: the values, their y coordinates with --2d,
+ * their --weights; with an integer --input-type, the samples themselves and
+ * their conversion to ELEMENT_TYPE in array
+ */
+struct s_input
+{
+        ELEMENT_TYPE *array;
+        ELEMENT_TYPE *y_array;
+        uint64_t *u64_weights;
+        double *double_weights;
+        void *int_array;
+};
+
+/* bins of a run or of its check: int counts, or with --weights 64-bit counts or double sums */
+struct s_histogram_bins
+{
+        int *counts;
+        uint64_t *u64_counts;
+        double *sums;
+};
+
+/* driver-side engines going through the library API instead of a compute function */
+static const struct s_histogram_engine context_engine = {"context", NULL};
+static const struct s_histogram_engine window_engine = {"window", NULL};
+/* all specs (--extra-specs) in one pass, and the omp engine once per spec for comparison */
+static const struct s_histogram_engine multi_engine = {"multi", NULL};
+static const struct s_histogram_engine omp_each_engine = {"omp-each", NULL};
+/* all arrays of a --batch in one call, each counted whole by one thread */
+static const struct s_histogram_engine batch_engine = {"batch", NULL};
+/* the omp engine on integer samples converted beforehand, for comparison */
+static const struct s_histogram_engine float_engine = {"float", NULL};
+
+static const struct s_histogram_engine *const driver_engines[] = {&context_engine, &window_engine, &multi_engine, &omp_each_engine,
+                                                                  &batch_engine, &float_engine};
+static const int nb_driver_engines = sizeof(driver_engines) / sizeof(driver_engines[0]);
 
 #define IO_CHECK(OP, RET)                   \
         do                                  \
@@ -51,8 +172,39 @@ static void usage(void)
         fprintf(stderr, "    --array-len  ARRAY_LENGTH\n");
         fprintf(stderr, "    --nb-bins  NB_BINS\n");
         fprintf(stderr, "    --lower-bound  LOWER_BOUND\n");
-        fprintf(stderr, "    --higher-bound  HIGHER_BOUND\n");
+        fprintf(stderr, "    --upper-bound  UPPER_BOUND\n");
+        fprintf(stderr, "    --scale  <linear|loglinear>\n");
+        fprintf(stderr, "    --precision  PRECISION\n");
+        fprintf(stderr, "    --2d\n");
+        fprintf(stderr, "    --y-nb-bins  Y_NB_BINS\n");
+        fprintf(stderr, "    --y-lower-bound  Y_LOWER_BOUND\n");
+        fprintf(stderr, "    --y-upper-bound  Y_UPPER_BOUND\n");
+        fprintf(stderr, "    --weights  <none|count|u64|double>\n");
+        fprintf(stderr, "    --input-type  <float|u8|u16|u32>\n");
+        fprintf(stderr, "    --sample-bits  SAMPLE_BITS\n");
+        fprintf(stderr, "    --engine  <");
+        int e;
+        for (e = 0; e < nb_histogram_engines; e++)
+        {
+                fprintf(stderr, "%s|", histogram_engines[e].name);
+        }
+        for (e = 0; e < nb_driver_engines; e++)
+        {
+                fprintf(stderr, "%s|", driver_engines[e]->name);
+        }
+        fprintf(stderr, "all>\n");
+        fprintf(stderr, "    --chunk-len CHUNK_LENGTH\n");
+        fprintf(stderr, "    --window WINDOW_LENGTH\n");
+        fprintf(stderr, "    --quantiles Q1,Q2,...\n");
+        fprintf(stderr, "    --extra-specs NB_BINS:LOWER_BOUND:UPPER_BOUND,...\n");
+        fprintf(stderr, "    --batch NB_ARRAYS\n");
         fprintf(stderr, "    --nb-repeat NB_REPEAT\n");
+        fprintf(stderr, "    --warmup NB_WARMUP\n");
+        fprintf(stderr, "    --min-time MIN_TIME\n");
+        fprintf(stderr, "    --no-pin\n");
+        fprintf(stderr, "    --summary\n");
+        fprintf(stderr, "    --perf-counters\n");
+        fprintf(stderr, "    --phase-timing\n");
         fprintf(stderr, "    --output\n");
         fprintf(stderr, "    --verbose\n");
         fprintf(stderr, "\n");
@@ -71,12 +223,97 @@ static void init_settings(struct s_settings **pp_settings)
         p_settings->nb_bins = DEFAULT_NB_BINS;
         p_settings->lower_bound = DEFAULT_LOWER_BOUND;
         p_settings->upper_bound = DEFAULT_UPPER_BOUND;
+        p_settings->scale = histogram_scale_linear;
+        p_settings->precision = DEFAULT_PRECISION;
+        p_settings->enable_2d = 0;
+        p_settings->y_nb_bins = DEFAULT_NB_BINS;
+        p_settings->y_lower_bound = DEFAULT_LOWER_BOUND;
+        p_settings->y_upper_bound = DEFAULT_UPPER_BOUND;
+        p_settings->weights = weights_none;
+        p_settings->input_type = input_float;
+        p_settings->sample_bits = 0;
+        p_settings->p_engine = histogram_find_engine(DEFAULT_ENGINE);
+        p_settings->chunk_len = DEFAULT_CHUNK_LEN;
+        p_settings->window_len = DEFAULT_WINDOW_LEN;
+        p_settings->batch_size = DEFAULT_BATCH_SIZE;
+        p_settings->nb_specs = 1;
         p_settings->nb_repeat = DEFAULT_NB_REPEAT;
+        p_settings->nb_warmup = DEFAULT_NB_WARMUP;
+        p_settings->min_time = DEFAULT_MIN_TIME;
+        p_settings->enable_pinning = 1;
+        p_settings->enable_summary = 0;
+        p_settings->enable_perf_counters = 0;
+        p_settings->enable_phase_timing = 0;
         p_settings->enable_verbose = 0;
         p_settings->enable_output = 0;
         *pp_settings = p_settings;
 }
 
+static const struct s_histogram_engine *find_engine(const char *name)
+{
+        int e;
+        for (e = 0; e < nb_driver_engines; e++)
+        {
+                if (strcmp(driver_engines[e]->name, name) == 0)
+                {
+                        return driver_engines[e];
+                }
+        }
+        return histogram_find_engine(name);
+}
+
+/*
+ * Pairs, weights and integer samples need the matching compute function,
+ * the float engine taking only the latter; with several
+ * arrays, only compute functions run array by array, and the batch engine
+ * takes them all.
+ */
+static int engine_supports_settings(const struct s_histogram_engine *p_engine, struct s_settings *p_settings)
+{
+        switch (p_settings->input_type)
+        {
+        case input_u8:
+                return p_engine == &float_engine || p_engine->compute_u8 != NULL;
+        case input_u16:
+                return p_engine == &float_engine || p_engine->compute_u16 != NULL;
+        case input_u32:
+                return p_engine == &float_engine || p_engine->compute_u32 != NULL;
+        default:
+                break;
+        }
+        if (p_engine == &float_engine)
+        {
+                return 0;
+        }
+        if (p_settings->enable_2d)
+        {
+                return p_engine->compute_2d != NULL;
+        }
+        if (p_settings->weights == weights_double)
+        {
+                return p_engine->compute_weighted != NULL;
+        }
+        if (p_settings->weights != weights_none)
+        {
+                return p_engine->compute_weighted_u64 != NULL;
+        }
+        return p_settings->batch_size == 1 || p_engine->compute != NULL || p_engine == &batch_engine;
+}
+
+/* option an engine may not support, for error messages */
+static const char *settings_input_option(struct s_settings *p_settings)
+{
+        if (p_settings->enable_2d)
+        {
+                return "--2d";
+        }
+        if (p_settings->input_type != input_float)
+        {
+                return "--input-type";
+        }
+        return (p_settings->weights != weights_none) ? "--weights" : "--batch";
+}
+
 static void parse_cmd_line(int argc, char *argv[], struct s_settings *p_settings)
 {
         int i = 1;
@@ -144,7 +381,46 @@ static void parse_cmd_line(int argc, char *argv[], struct s_settings *p_settings
                         }
                         p_settings->upper_bound = value;
                 }
-                else if (strcmp(argv[i], "--nb-repeat") == 0)
+                else if (strcmp(argv[i], "--scale") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        if (strcmp(argv[i], "linear") == 0)
+                        {
+                                p_settings->scale = histogram_scale_linear;
+                        }
+                        else if (strcmp(argv[i], "loglinear") == 0)
+                        {
+                                p_settings->scale = histogram_scale_loglinear;
+                        }
+                        else
+                        {
+                                usage();
+                        }
+                }
+                else if (strcmp(argv[i], "--precision") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        int value = atoi(argv[i]);
+                        if (value < 0 || value > HISTOGRAM_MAX_PRECISION)
+                        {
+                                fprintf(stderr, "invalid PRECISION argument\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        p_settings->precision = value;
+                }
+                else if (strcmp(argv[i], "--2d") == 0)
+                {
+                        p_settings->enable_2d = 1;
+                }
+                else if (strcmp(argv[i], "--y-nb-bins") == 0)
                 {
                         i++;
                         if (i >= argc)
@@ -154,280 +430,1295 @@ static void parse_cmd_line(int argc, char *argv[], struct s_settings *p_settings
                         int value = atoi(argv[i]);
                         if (value < 1)
                         {
-                                fprintf(stderr, "invalid NB_REPEAT argument\n");
+                                fprintf(stderr, "invalid Y_NB_BINS argument\n");
                                 exit(EXIT_FAILURE);
                         }
-                        p_settings->nb_repeat = value;
+                        p_settings->y_nb_bins = value;
+                        p_settings->enable_2d = 1;
                 }
-                else if (strcmp(argv[i], "--output") == 0)
+                else if (strcmp(argv[i], "--y-lower-bound") == 0)
                 {
-                        p_settings->enable_output = 1;
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        float value = atof(argv[i]);
+                        int class = fpclassify(value);
+                        if ((class != FP_NORMAL) && (class != FP_ZERO))
+                        {
+                                fprintf(stderr, "invalid Y_LOWER_BOUND argument\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        p_settings->y_lower_bound = value;
+                        p_settings->enable_2d = 1;
                 }
-                else if (strcmp(argv[i], "--verbose") == 0)
+                else if (strcmp(argv[i], "--y-upper-bound") == 0)
                 {
-                        p_settings->enable_verbose = 1;
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        float value = atof(argv[i]);
+                        int class = fpclassify(value);
+                        if ((class != FP_NORMAL) && (class != FP_ZERO))
+                        {
+                                fprintf(stderr, "invalid Y_UPPER_BOUND argument\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        p_settings->y_upper_bound = value;
+                        p_settings->enable_2d = 1;
                 }
-                else
+                else if (strcmp(argv[i], "--weights") == 0)
                 {
-                        usage();
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        int w;
+                        for (w = 0; w <= weights_double; w++)
+                        {
+                                if (strcmp(argv[i], weights_names[w]) == 0)
+                                {
+                                        break;
+                                }
+                        }
+                        if (w > weights_double)
+                        {
+                                usage();
+                        }
+                        p_settings->weights = (enum e_weights)w;
                 }
-
-                i++;
-        }
-
-        if (p_settings->upper_bound <= p_settings->lower_bound)
-        {
-                fprintf(stderr, "invalid histogram bounds\n");
-                exit(EXIT_FAILURE);
-        }
-
-        if (p_settings->enable_output)
-        {
-                p_settings->nb_repeat = 1;
-        }
-}
-
-static void delete_settings(struct s_settings **pp_settings)
-{
-        assert(*pp_settings != NULL);
-        free(*pp_settings);
-        pp_settings = NULL;
-}
-
-static void allocate_array(ELEMENT_TYPE **p_array, struct s_settings *p_settings)
-{
-        assert(*p_array == NULL);
-        ELEMENT_TYPE *array = calloc(p_settings->array_len, sizeof(*array));
-        if (array == NULL)
-        {
-                PRINT_ERROR("memory allocation failed");
-        }
-        *p_array = array;
-}
-
-static void delete_array(ELEMENT_TYPE **p_array)
-{
-        assert(*p_array != NULL);
-        free(*p_array);
-        p_array = NULL;
-}
-
-static void init_array_random(ELEMENT_TYPE *array, struct s_settings *p_settings)
-{
-        const ELEMENT_TYPE offset = p_settings->lower_bound;
-        const ELEMENT_TYPE scale = p_settings->upper_bound - p_settings->lower_bound;
-
-        int i;
-        for (i = 0; i < p_settings->array_len; i++)
-        {
-                ELEMENT_TYPE value = scale * ((ELEMENT_TYPE)rand()) / (1.0 + (ELEMENT_TYPE)(RAND_MAX)) + offset;
-                array[i] = value;
-        }
-}
-
-static void print_array(const ELEMENT_TYPE *array, struct s_settings *p_settings)
-{
-        printf("[");
-        int j = 0;
-        int i;
-        for (i = 0; i < p_settings->array_len; i++)
-        {
-                if (i > 0)
+                else if (strcmp(argv[i], "--input-type") == 0)
                 {
-                        printf(",");
-                        if ((i % MAX_DISPLAY_COLUMNS == 0))
+                        i++;
+                        if (i >= argc)
                         {
-                                printf("\n");
-                                printf(" ");
-                                j++;
-
-                                if (j >= MAX_DISPLAY_ROWS)
+                                usage();
+                        }
+                        int t;
+                        for (t = 0; t <= input_u32; t++)
+                        {
+                                if (strcmp(argv[i], input_type_names[t]) == 0)
                                 {
-                                        printf("  ...\n");
                                         break;
                                 }
                         }
+                        if (t > input_u32)
+                        {
+                                usage();
+                        }
+                        p_settings->input_type = (enum e_input_type)t;
                 }
-                printf(" %8.3lg", array[i]);
-        }
-        printf(" ]");
-}
-
-static void write_array_to_file(FILE *file, const ELEMENT_TYPE *array, struct s_settings *p_settings)
-{
-        int i;
-        int ret;
-
-        for (i = 0; i < p_settings->array_len; i++)
-        {
-                ret = fprintf(file, "%lf\n", array[i]);
-                IO_CHECK("fprintf", ret);
-        }
-}
-
-static void allocate_histogram(int **p_histogram, struct s_settings *p_settings)
-{
-        assert(*p_histogram == NULL);
-        int *histogram = calloc(p_settings->nb_bins, sizeof(*histogram));
-        if (histogram == NULL)
-        {
-                PRINT_ERROR("memory allocation failed");
-        }
-        *p_histogram = histogram;
-}
-
-static void delete_histogram(int **p_histogram)
-{
-        assert(*p_histogram != NULL);
-        free(*p_histogram);
-        p_histogram = NULL;
-}
-
-static void print_histogram(const int *histogram, struct s_settings *p_settings)
-{
-        const ELEMENT_TYPE offset = p_settings->lower_bound;
-        const ELEMENT_TYPE scale = p_settings->upper_bound - p_settings->lower_bound;
-
-        printf("<\n");
-        int i;
-        for (i = 0; i < p_settings->nb_bins; i++)
-        {
-                ELEMENT_TYPE lower = offset + i * scale / p_settings->nb_bins;
-                ELEMENT_TYPE upper = offset + (i + 1) * scale / p_settings->nb_bins;
-
-                printf(" [ %8.2lg ... %8.2lg [ :  %d\n", lower, upper, histogram[i]);
-        }
-        printf(">");
-}
-
-static void write_bins_to_file(FILE *file, struct s_settings *p_settings)
-{
-        int i;
-        int ret;
-
-        const ELEMENT_TYPE offset = p_settings->lower_bound;
-        const ELEMENT_TYPE scale = p_settings->upper_bound - p_settings->lower_bound;
-
-        ret = fprintf(file, "%lf\n", offset);
-        IO_CHECK("fprintf", ret);
-        for (i = 0; i < p_settings->nb_bins; i++)
-        {
-                ELEMENT_TYPE bound = offset + (i + 1) * scale / p_settings->nb_bins;
-                ret = fprintf(file, "%lf\n", bound);
-                IO_CHECK("fprintf", ret);
-        }
-}
-
-static void write_histogram_to_file(FILE *file, const int *histogram, struct s_settings *p_settings)
-{
-        int i;
-        int ret;
-
-        for (i = 0; i < p_settings->nb_bins; i++)
-        {
-                ret = fprintf(file, "%d\n", histogram[i]);
-                IO_CHECK("fprintf", ret);
-        }
+                else if (strcmp(argv[i], "--sample-bits") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        int value = atoi(argv[i]);
+                        if (value < 1 || value > 32)
+                        {
+                                fprintf(stderr, "invalid SAMPLE_BITS argument\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        p_settings->sample_bits = value;
+                }
+                else if (strcmp(argv[i], "--engine") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        if (strcmp(argv[i], "all") == 0)
+                        {
+                                p_settings->p_engine = NULL;
+                        }
+                        else
+                        {
+                                p_settings->p_engine = find_engine(argv[i]);
+                                if (p_settings->p_engine == NULL)
+                                {
+                                        fprintf(stderr, "invalid or unavailable engine '%s'\n", argv[i]);
+                                        exit(EXIT_FAILURE);
+                                }
+                        }
+                }
+                else if (strcmp(argv[i], "--chunk-len") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        int value = atoi(argv[i]);
+                        if (value < 0)
+                        {
+                                fprintf(stderr, "invalid CHUNK_LENGTH argument\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        p_settings->chunk_len = value;
+                }
+                else if (strcmp(argv[i], "--window") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        int value = atoi(argv[i]);
+                        if (value < 0)
+                        {
+                                fprintf(stderr, "invalid WINDOW_LENGTH argument\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        p_settings->window_len = value;
+                }
+                else if (strcmp(argv[i], "--quantiles") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        const char *p_value = argv[i];
+                        p_settings->nb_quantiles = 0;
+                        while (*p_value != '\0')
+                        {
+                                char *p_end = NULL;
+                                double value = strtod(p_value, &p_end);
+                                if (p_end == p_value || !(value >= 0.0 && value <= 1.0) || (*p_end != ',' && *p_end != '\0') ||
+                                    p_settings->nb_quantiles >= MAX_QUANTILES)
+                                {
+                                        fprintf(stderr, "invalid QUANTILES argument\n");
+                                        exit(EXIT_FAILURE);
+                                }
+                                p_settings->quantiles[p_settings->nb_quantiles++] = value;
+                                p_value = (*p_end == ',') ? p_end + 1 : p_end;
+                        }
+                }
+                else if (strcmp(argv[i], "--batch") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        int value = atoi(argv[i]);
+                        if (value < 1)
+                        {
+                                fprintf(stderr, "invalid NB_ARRAYS argument\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        p_settings->batch_size = value;
+                }
+                else if (strcmp(argv[i], "--extra-specs") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        const char *p_value = argv[i];
+                        p_settings->nb_specs = 1;
+                        while (*p_value != '\0')
+                        {
+                                struct s_histogram_spec spec = {0};
+                                int nb_chars = 0;
+                                if (p_settings->nb_specs >= MAX_SPECS ||
+                                    sscanf(p_value, "%d:%lf:%lf%n", &spec.nb_bins, &spec.lower_bound, &spec.upper_bound, &nb_chars) != 3 ||
+                                    (p_value[nb_chars] != ',' && p_value[nb_chars] != '\0'))
+                                {
+                                        fprintf(stderr, "invalid EXTRA_SPECS argument\n");
+                                        exit(EXIT_FAILURE);
+                                }
+                                spec.scale = histogram_scale_linear;
+                                if (!histogram_spec_is_valid(&spec))
+                                {
+                                        fprintf(stderr, "invalid EXTRA_SPECS argument\n");
+                                        exit(EXIT_FAILURE);
+                                }
+                                p_settings->specs[p_settings->nb_specs++] = spec;
+                                p_value += nb_chars;
+                                if (*p_value == ',')
+                                {
+                                        p_value++;
+                                }
+                        }
+                }
+                else if (strcmp(argv[i], "--nb-repeat") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        int value = atoi(argv[i]);
+                        if (value < 1)
+                        {
+                                fprintf(stderr, "invalid NB_REPEAT argument\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        p_settings->nb_repeat = value;
+                }
+                else if (strcmp(argv[i], "--warmup") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        int value = atoi(argv[i]);
+                        if (value < 0)
+                        {
+                                fprintf(stderr, "invalid NB_WARMUP argument\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        p_settings->nb_warmup = value;
+                }
+                else if (strcmp(argv[i], "--min-time") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        double value = atof(argv[i]);
+                        if (!(value >= 0.0))
+                        {
+                                fprintf(stderr, "invalid MIN_TIME argument\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        p_settings->min_time = value;
+                }
+                else if (strcmp(argv[i], "--no-pin") == 0)
+                {
+                        p_settings->enable_pinning = 0;
+                }
+                else if (strcmp(argv[i], "--summary") == 0)
+                {
+                        p_settings->enable_summary = 1;
+                }
+                else if (strcmp(argv[i], "--perf-counters") == 0)
+                {
+                        p_settings->enable_perf_counters = 1;
+                }
+                else if (strcmp(argv[i], "--phase-timing") == 0)
+                {
+                        p_settings->enable_phase_timing = 1;
+                }
+                else if (strcmp(argv[i], "--output") == 0)
+                {
+                        p_settings->enable_output = 1;
+                }
+                else if (strcmp(argv[i], "--verbose") == 0)
+                {
+                        p_settings->enable_verbose = 1;
+                }
+                else
+                {
+                        usage();
+                }
+
+                i++;
+        }
+
+        if (p_settings->upper_bound <= p_settings->lower_bound || p_settings->y_upper_bound <= p_settings->y_lower_bound)
+        {
+                fprintf(stderr, "invalid histogram bounds\n");
+                exit(EXIT_FAILURE);
+        }
+
+        /* loglinear bins cover every non-negative float, the bounds only shape the generated data */
+        if (p_settings->scale == histogram_scale_loglinear)
+        {
+                p_settings->nb_bins = HISTOGRAM_LOGLINEAR_NB_BINS(p_settings->precision);
+        }
+
+        p_settings->spec.nb_bins = p_settings->nb_bins;
+        p_settings->spec.lower_bound = p_settings->lower_bound;
+        p_settings->spec.upper_bound = p_settings->upper_bound;
+        p_settings->spec.scale = p_settings->scale;
+        p_settings->spec.precision = p_settings->precision;
+        p_settings->specs[0] = p_settings->spec;
+
+        p_settings->spec_2d.x = p_settings->spec;
+        p_settings->spec_2d.y.nb_bins = p_settings->y_nb_bins;
+        p_settings->spec_2d.y.lower_bound = p_settings->y_lower_bound;
+        p_settings->spec_2d.y.upper_bound = p_settings->y_upper_bound;
+        p_settings->spec_2d.y.scale = histogram_scale_linear;
+        p_settings->spec_2d.y.precision = 0;
+        if (p_settings->enable_2d && (long long)p_settings->nb_bins * p_settings->y_nb_bins > INT_MAX)
+        {
+                fprintf(stderr, "invalid Y_NB_BINS argument: too many cells\n");
+                exit(EXIT_FAILURE);
+        }
+        p_settings->nb_cells = p_settings->enable_2d ? p_settings->nb_bins * p_settings->y_nb_bins : p_settings->nb_bins;
+
+        /* by default, integer samples fill the 12 bits of a typical ADC, or the whole type when narrower */
+        if (p_settings->input_type == input_float)
+        {
+                if (p_settings->sample_bits != 0)
+                {
+                        fprintf(stderr, "--sample-bits needs an integer --input-type\n");
+                        exit(EXIT_FAILURE);
+                }
+        }
+        else if (p_settings->sample_bits == 0)
+        {
+                const int type_bits = input_type_bits[p_settings->input_type];
+                p_settings->sample_bits = (type_bits < DEFAULT_SAMPLE_BITS) ? type_bits : DEFAULT_SAMPLE_BITS;
+        }
+        else if (p_settings->sample_bits > input_type_bits[p_settings->input_type])
+        {
+                fprintf(stderr, "SAMPLE_BITS does not fit in %s samples\n", input_type_names[p_settings->input_type]);
+                exit(EXIT_FAILURE);
+        }
+
+        /* pairs, weighted and integer samples are only counted whole, into a single histogram */
+        if ((p_settings->enable_2d != 0) + (p_settings->weights != weights_none) + (p_settings->input_type != input_float) > 1)
+        {
+                fprintf(stderr, "--2d, --weights and --input-type cannot be combined\n");
+                exit(EXIT_FAILURE);
+        }
+        if ((p_settings->enable_2d || p_settings->weights != weights_none || p_settings->input_type != input_float) &&
+            (p_settings->batch_size > 1 || p_settings->nb_specs > 1))
+        {
+                fprintf(stderr, "%s cannot be combined with --batch or --extra-specs\n", settings_input_option(p_settings));
+                exit(EXIT_FAILURE);
+        }
+        /* quantiles are read from int counts */
+        if ((p_settings->enable_2d || p_settings->weights != weights_none) && p_settings->nb_quantiles > 0)
+        {
+                fprintf(stderr, "%s cannot be combined with --quantiles\n", settings_input_option(p_settings));
+                exit(EXIT_FAILURE);
+        }
+
+        if (p_settings->p_engine == &float_engine && p_settings->input_type == input_float)
+        {
+                fprintf(stderr, "engine 'float' needs an integer --input-type\n");
+                exit(EXIT_FAILURE);
+        }
+        /* a batch is batch_size arrays of array_len elements, one after the other */
+        if (p_settings->p_engine != NULL && !engine_supports_settings(p_settings->p_engine, p_settings))
+        {
+                fprintf(stderr, "engine '%s' does not support %s\n", p_settings->p_engine->name, settings_input_option(p_settings));
+                exit(EXIT_FAILURE);
+        }
+        if ((long long)p_settings->nb_cells * p_settings->batch_size > INT_MAX)
+        {
+                fprintf(stderr, "invalid NB_ARRAYS argument: too many histograms\n");
+                exit(EXIT_FAILURE);
+        }
+        p_settings->batch_offsets = calloc(p_settings->batch_size + 1, sizeof(*p_settings->batch_offsets));
+        if (p_settings->batch_offsets == NULL)
+        {
+                PRINT_ERROR("memory allocation failed");
+        }
+        int b;
+        for (b = 0; b <= p_settings->batch_size; b++)
+        {
+                p_settings->batch_offsets[b] = (size_t)b * p_settings->array_len;
+        }
+
+        /* the default window covers the whole array */
+        if (p_settings->window_len == 0)
+        {
+                p_settings->window_len = p_settings->array_len;
+        }
+
+        if (p_settings->enable_output)
+        {
+                p_settings->nb_repeat = 1;
+                p_settings->nb_warmup = 0;
+                p_settings->min_time = 0.0;
+        }
+}
+
+static void delete_settings(struct s_settings **pp_settings)
+{
+        assert(*pp_settings != NULL);
+        free((*pp_settings)->batch_offsets);
+        free(*pp_settings);
+        pp_settings = NULL;
+}
+
+static void allocate_input(struct s_input *p_input, struct s_settings *p_settings)
+{
+        assert(p_input->array == NULL);
+        const size_t nb_elements = p_settings->batch_offsets[p_settings->batch_size];
+        p_input->array = calloc(nb_elements, sizeof(*p_input->array));
+        if (p_input->array == NULL)
+        {
+                PRINT_ERROR("memory allocation failed");
+        }
+        if (p_settings->enable_2d)
+        {
+                p_input->y_array = calloc(nb_elements, sizeof(*p_input->y_array));
+                if (p_input->y_array == NULL)
+                {
+                        PRINT_ERROR("memory allocation failed");
+                }
+        }
+        if (p_settings->weights == weights_u64)
+        {
+                p_input->u64_weights = calloc(nb_elements, sizeof(*p_input->u64_weights));
+                if (p_input->u64_weights == NULL)
+                {
+                        PRINT_ERROR("memory allocation failed");
+                }
+        }
+        else if (p_settings->weights == weights_double)
+        {
+                p_input->double_weights = calloc(nb_elements, sizeof(*p_input->double_weights));
+                if (p_input->double_weights == NULL)
+                {
+                        PRINT_ERROR("memory allocation failed");
+                }
+        }
+        if (p_settings->input_type != input_float)
+        {
+                p_input->int_array = calloc(nb_elements, input_type_bits[p_settings->input_type] / 8);
+                if (p_input->int_array == NULL)
+                {
+                        PRINT_ERROR("memory allocation failed");
+                }
+        }
+}
+
+static void delete_input(struct s_input *p_input)
+{
+        assert(p_input->array != NULL);
+        free(p_input->array);
+        free(p_input->y_array);
+        free(p_input->u64_weights);
+        free(p_input->double_weights);
+        free(p_input->int_array);
+        p_input->array = NULL;
+        p_input->y_array = NULL;
+        p_input->u64_weights = NULL;
+        p_input->double_weights = NULL;
+        p_input->int_array = NULL;
+}
+
+/* uniform SAMPLE_BITS-bit samples, as read from an ADC, and their conversion to ELEMENT_TYPE */
+static void init_int_input_random(struct s_input *p_input, struct s_settings *p_settings)
+{
+        const uint32_t mask = (p_settings->sample_bits == 32) ? 0xffffffffu : (1u << p_settings->sample_bits) - 1;
+
+        size_t i;
+        for (i = 0; i < p_settings->batch_offsets[p_settings->batch_size]; i++)
+        {
+                /* rand() only guarantees 15 random bits */
+                uint32_t value = (((uint32_t)rand() << 30) ^ ((uint32_t)rand() << 15) ^ (uint32_t)rand()) & mask;
+                switch (p_settings->input_type)
+                {
+                case input_u8:
+                        ((uint8_t *)p_input->int_array)[i] = (uint8_t)value;
+                        break;
+                case input_u16:
+                        ((uint16_t *)p_input->int_array)[i] = (uint16_t)value;
+                        break;
+                default:
+                        ((uint32_t *)p_input->int_array)[i] = value;
+                        break;
+                }
+                p_input->array[i] = (ELEMENT_TYPE)value;
+        }
+}
+
+static void init_input_random(struct s_input *p_input, struct s_settings *p_settings)
+{
+        if (p_input->int_array != NULL)
+        {
+                init_int_input_random(p_input, p_settings);
+                return;
+        }
+
+        const ELEMENT_TYPE offset = p_settings->lower_bound;
+        const ELEMENT_TYPE scale = p_settings->upper_bound - p_settings->lower_bound;
+        const ELEMENT_TYPE y_offset = p_settings->y_lower_bound;
+        const ELEMENT_TYPE y_scale = p_settings->y_upper_bound - p_settings->y_lower_bound;
+
+        size_t i;
+        for (i = 0; i < p_settings->batch_offsets[p_settings->batch_size]; i++)
+        {
+                ELEMENT_TYPE u = ((ELEMENT_TYPE)rand()) / (1.0 + (ELEMENT_TYPE)(RAND_MAX));
+                p_input->array[i] = scale * u + offset;
+                if (p_input->y_array != NULL)
+                {
+                        /* y loosely follows x, so that the joint distribution is not flat */
+                        ELEMENT_TYPE v = ((ELEMENT_TYPE)rand()) / (1.0 + (ELEMENT_TYPE)(RAND_MAX));
+                        p_input->y_array[i] = y_scale * (0.5 * u + 0.5 * v) + y_offset;
+                }
+                if (p_input->u64_weights != NULL)
+                {
+                        /* e.g. payload sizes in bytes */
+                        p_input->u64_weights[i] = (uint64_t)(((double)rand()) / (1.0 + (double)RAND_MAX) * (1 << 20));
+                }
+                else if (p_input->double_weights != NULL)
+                {
+                        p_input->double_weights[i] = pow(10.0, WEIGHT_DECADES * ((double)rand()) / (1.0 + (double)RAND_MAX));
+                }
+        }
+}
+
+static void print_array(const ELEMENT_TYPE *array, struct s_settings *p_settings)
+{
+        printf("[");
+        int j = 0;
+        int i;
+        for (i = 0; i < p_settings->array_len; i++)
+        {
+                if (i > 0)
+                {
+                        printf(",");
+                        if ((i % MAX_DISPLAY_COLUMNS == 0))
+                        {
+                                printf("\n");
+                                printf(" ");
+                                j++;
+
+                                if (j >= MAX_DISPLAY_ROWS)
+                                {
+                                        printf("  ...\n");
+                                        break;
+                                }
+                        }
+                }
+                printf(" %8.3lg", array[i]);
+        }
+        printf(" ]");
+}
+
+static void write_input_to_file(FILE *file, const struct s_input *p_input, struct s_settings *p_settings)
+{
+        int i;
+        int ret;
+
+        for (i = 0; i < p_settings->array_len; i++)
+        {
+                if (p_input->y_array != NULL)
+                {
+                        ret = fprintf(file, "%lf,%lf\n", p_input->array[i], p_input->y_array[i]);
+                }
+                else
+                {
+                        ret = fprintf(file, "%lf\n", p_input->array[i]);
+                }
+                IO_CHECK("fprintf", ret);
+        }
+}
+
+static void allocate_histogram(int **p_histogram, int nb_bins)
+{
+        assert(*p_histogram == NULL);
+        int *histogram = calloc(nb_bins, sizeof(*histogram));
+        if (histogram == NULL)
+        {
+                PRINT_ERROR("memory allocation failed");
+        }
+        *p_histogram = histogram;
+}
+
+static void delete_histogram(int **p_histogram)
+{
+        assert(*p_histogram != NULL);
+        free(*p_histogram);
+        p_histogram = NULL;
+}
+
+/* only the bins of the selected --weights are allocated */
+static void allocate_bins(struct s_histogram_bins *p_bins, int nb_bins, struct s_settings *p_settings)
+{
+        assert(p_bins->counts == NULL && p_bins->u64_counts == NULL && p_bins->sums == NULL);
+        if (p_settings->weights == weights_none)
+        {
+                allocate_histogram(&p_bins->counts, nb_bins);
+                return;
+        }
+        if (p_settings->weights == weights_double)
+        {
+                p_bins->sums = calloc(nb_bins, sizeof(*p_bins->sums));
+        }
+        else
+        {
+                p_bins->u64_counts = calloc(nb_bins, sizeof(*p_bins->u64_counts));
+        }
+        if (p_bins->sums == NULL && p_bins->u64_counts == NULL)
+        {
+                PRINT_ERROR("memory allocation failed");
+        }
+}
+
+static void delete_bins(struct s_histogram_bins *p_bins)
+{
+        if (p_bins->counts != NULL)
+        {
+                delete_histogram(&p_bins->counts);
+        }
+        free(p_bins->u64_counts);
+        free(p_bins->sums);
+        p_bins->counts = NULL;
+        p_bins->u64_counts = NULL;
+        p_bins->sums = NULL;
+}
+
+/* y bins top down, x bins left to right */
+static void print_histogram_2d(const int *histogram, struct s_settings *p_settings)
+{
+        const int nb_x_bins = p_settings->nb_bins;
+        const int nb_y_bins = p_settings->y_nb_bins;
+        int jy;
+        for (jy = nb_y_bins - 1; jy >= 0; jy--)
+        {
+                if (jy < nb_y_bins - MAX_DISPLAY_ROWS)
+                {
+                        printf("  ...\n");
+                        break;
+                }
+                printf(" %8.2lg |", histogram_bin_edge(&p_settings->spec_2d.y, jy));
+                int jx;
+                for (jx = 0; jx < nb_x_bins && jx < MAX_DISPLAY_COLUMNS; jx++)
+                {
+                        printf(" %6d", histogram[jy * nb_x_bins + jx]);
+                }
+                printf("%s\n", (jx < nb_x_bins) ? " ..." : "");
+        }
+}
+
+static void print_histogram(const struct s_histogram_bins *p_bins, struct s_settings *p_settings)
+{
+        if (p_settings->enable_2d)
+        {
+                print_histogram_2d(p_bins->counts, p_settings);
+                return;
+        }
+        printf("<\n");
+        int i;
+        for (i = 0; i < p_settings->nb_bins; i++)
+        {
+                ELEMENT_TYPE lower = histogram_bin_edge(&p_settings->spec, i);
+                ELEMENT_TYPE upper = histogram_bin_edge(&p_settings->spec, i + 1);
+
+                printf(" [ %8.2lg ... %8.2lg [ :  ", lower, upper);
+                if (p_bins->sums != NULL)
+                {
+                        printf("%.17g\n", p_bins->sums[i]);
+                }
+                else if (p_bins->u64_counts != NULL)
+                {
+                        printf("%llu\n", (unsigned long long)p_bins->u64_counts[i]);
+                }
+                else
+                {
+                        printf("%d\n", p_bins->counts[i]);
+                }
+        }
+        printf(">");
+}
+
+static void write_bins_to_file(const char *filename, const struct s_histogram_spec *p_spec)
+{
+        FILE *file = fopen(filename, "w");
+        if (file == NULL)
+        {
+                perror("fopen");
+                exit(EXIT_FAILURE);
+        }
+
+        int i;
+        int ret;
+        for (i = 0; i <= p_spec->nb_bins; i++)
+        {
+                ELEMENT_TYPE bound = histogram_bin_edge(p_spec, i);
+                ret = fprintf(file, "%lf\n", bound);
+                IO_CHECK("fprintf", ret);
+        }
+        fclose(file);
+}
+
+/* one line per bin, or with --2d one line per y bin and one column per x bin */
+static void write_histogram_to_file(FILE *file, const struct s_histogram_bins *p_bins, struct s_settings *p_settings)
+{
+        const int nb_columns = p_settings->enable_2d ? p_settings->nb_bins : 1;
+        int i;
+        int ret;
+
+        for (i = 0; i < p_settings->nb_cells; i++)
+        {
+                const char *separator = (i % nb_columns == nb_columns - 1) ? "\n" : ",";
+                if (p_bins->sums != NULL)
+                {
+                        ret = fprintf(file, "%.17g%s", p_bins->sums[i], separator);
+                }
+                else if (p_bins->u64_counts != NULL)
+                {
+                        ret = fprintf(file, "%llu%s", (unsigned long long)p_bins->u64_counts[i], separator);
+                }
+                else
+                {
+                        ret = fprintf(file, "%d%s", p_bins->counts[i], separator);
+                }
+                IO_CHECK("fprintf", ret);
+        }
+}
+
+/* the binary format also keeps the out of range counts, which engines do not return */
+static void write_histogram_binary(const char *filename, const int *histogram, const ELEMENT_TYPE *array, int array_len, struct s_settings *p_settings)
+{
+        const int nb_bins = p_settings->nb_bins;
+        uint64_t *counts = calloc(nb_bins + 2, sizeof(*counts));
+        if (counts == NULL)
+        {
+                PRINT_ERROR("memory allocation failed");
+        }
+
+        int j;
+        for (j = 0; j < nb_bins; j++)
+        {
+                counts[j] = histogram[j];
+        }
+
+        const struct s_histogram_binning binning = histogram_binning(&p_settings->spec);
+        int i;
+        for (i = 0; i < array_len; i++)
+        {
+                int slot = histogram_binning_slot(&binning, array[i]);
+                if (slot >= nb_bins)
+                {
+                        counts[slot]++;
+                }
+        }
+
+        if (histogram_write_file(filename, &p_settings->spec, counts) != 0)
+        {
+                perror(filename);
+                exit(EXIT_FAILURE);
+        }
+        free(counts);
+}
+
+static void print_settings_csv_header(struct s_settings *p_settings)
+{
+        printf("engine,array_len,nb_bins,nb_repeat");
+        if (p_settings->batch_size > 1)
+        {
+                printf(",batch_size");
+        }
+        if (p_settings->enable_2d)
+        {
+                printf(",y_nb_bins");
+        }
+        if (p_settings->weights != weights_none)
+        {
+                printf(",weights");
+        }
+        if (p_settings->input_type != input_float)
+        {
+                printf(",input_type,sample_bits");
+        }
+}
+
+static void print_settings_csv(const struct s_histogram_engine *p_engine, struct s_settings *p_settings)
+{
+        printf("%s,%d,%d,%d", p_engine->name, p_settings->array_len, p_settings->nb_bins, p_settings->nb_repeat);
+        if (p_settings->batch_size > 1)
+        {
+                printf(",%d", p_settings->batch_size);
+        }
+        if (p_settings->enable_2d)
+        {
+                printf(",%d", p_settings->y_nb_bins);
+        }
+        if (p_settings->weights != weights_none)
+        {
+                printf(",%s", weights_names[p_settings->weights]);
+        }
+        if (p_settings->input_type != input_float)
+        {
+                printf(",%s,%d", input_type_names[p_settings->input_type], p_settings->sample_bits);
+        }
+}
+
+static void print_results_csv_header(void)
+{
+        printf("rep,timing,check_status");
+}
+
+static void print_results_csv(int rep, double timing_in_seconds, int check_status)
+{
+        printf("%d,%le,%d", rep, timing_in_seconds, check_status);
+}
+
+static void print_quantiles_csv_header(struct s_settings *p_settings)
+{
+        int q;
+        for (q = 0; q < p_settings->nb_quantiles; q++)
+        {
+                printf(",q%g", p_settings->quantiles[q]);
+        }
+}
+
+static void print_quantiles_csv(const struct s_engine_run *p_run, struct s_settings *p_settings)
+{
+        int q;
+        for (q = 0; q < p_settings->nb_quantiles; q++)
+        {
+                printf(",%le", p_run->quantiles[q]);
+        }
+}
+
+static void print_csv_header(struct s_settings *p_settings)
+{
+        print_settings_csv_header(p_settings);
+        printf(",");
+        print_results_csv_header();
+        if (p_settings->enable_phase_timing)
+        {
+                printf(",");
+                phase_timer_print_csv_header();
+        }
+        if (p_settings->enable_perf_counters)
+        {
+                printf(",");
+                perf_counters_print_csv_header();
+        }
+        print_quantiles_csv_header(p_settings);
+        printf("\n");
+}
+
+static void print_summary_csv_header(struct s_settings *p_settings)
+{
+        print_settings_csv_header(p_settings);
+        printf(",");
+        bench_print_stats_csv_header();
+        printf(",elements_per_s,gb_per_s,check_status");
+        if (p_settings->enable_phase_timing)
+        {
+                printf(",");
+                phase_timer_print_csv_header();
+        }
+        if (p_settings->enable_perf_counters)
+        {
+                printf(",");
+                perf_counters_print_csv_header();
+        }
+        print_quantiles_csv_header(p_settings);
+        printf("\n");
 }
 
-static void print_settings_csv_header(void)
+static void print_summary_csv(const struct s_engine_run *p_run, struct s_settings *p_settings)
 {
-        printf("array_len,nb_bins,nb_repeat");
-}
+        struct s_bench_stats stats;
+        bench_compute_stats(&p_run->samples, &stats);
 
-static void print_settings_csv(struct s_settings *p_settings)
-{
-        printf("%d,%d,%d", p_settings->array_len, p_settings->nb_bins, p_settings->nb_repeat);
+        const double nb_elements = (double)p_settings->batch_offsets[p_settings->batch_size];
+        /* a pair reads both of its coordinates, a weighted sample its weight, an integer sample its own width */
+        double bytes_per_element = sizeof(ELEMENT_TYPE) * (p_settings->enable_2d ? 2 : 1);
+        if (p_settings->input_type != input_float && p_run->p_engine != &float_engine)
+        {
+                bytes_per_element = input_type_bits[p_settings->input_type] / 8;
+        }
+        if (p_settings->weights == weights_u64)
+        {
+                bytes_per_element += sizeof(uint64_t);
+        }
+        else if (p_settings->weights == weights_double)
+        {
+                bytes_per_element += sizeof(double);
+        }
+        const double nb_bytes = nb_elements * bytes_per_element;
+
+        print_settings_csv(p_run->p_engine, p_settings);
+        printf(",");
+        bench_print_stats_csv(&stats);
+        printf(",");
+        bench_print_throughput_csv(nb_elements, nb_bytes, &stats);
+        printf(",%d", p_run->check_status);
+        if (p_settings->enable_phase_timing)
+        {
+                printf(",");
+                phase_timer_print_mean_csv(&p_run->phase_timer);
+        }
+        if (p_settings->enable_perf_counters)
+        {
+                printf(",");
+                perf_counters_print_mean_csv(&p_run->perf_counters);
+        }
+        print_quantiles_csv(p_run, p_settings);
+        printf("\n");
 }
 
-static void print_results_csv_header(void)
+static void init_engine_runs(struct s_engine_run **pp_runs, int *p_nb_runs, struct s_settings *p_settings)
 {
-        printf("rep,timing,check_status");
+        assert(*pp_runs == NULL);
+        const struct s_histogram_engine *engines[nb_histogram_engines + nb_driver_engines];
+        int nb_runs = 0;
+        int e;
+        if (p_settings->p_engine != NULL)
+        {
+                engines[nb_runs++] = p_settings->p_engine;
+        }
+        else
+        {
+                for (e = 0; e < nb_histogram_engines + nb_driver_engines; e++)
+                {
+                        const struct s_histogram_engine *p_engine =
+                            (e < nb_histogram_engines) ? &histogram_engines[e] : driver_engines[e - nb_histogram_engines];
+                        if (engine_supports_settings(p_engine, p_settings))
+                        {
+                                engines[nb_runs++] = p_engine;
+                        }
+                }
+        }
+
+        struct s_engine_run *p_runs = calloc(nb_runs, sizeof(*p_runs));
+        if (p_runs == NULL)
+        {
+                PRINT_ERROR("memory allocation failed");
+        }
+
+        for (e = 0; e < nb_runs; e++)
+        {
+                struct s_engine_run *p_run = &p_runs[e];
+                p_run->p_engine = engines[e];
+                bench_samples_init(&p_run->samples);
+                if (p_settings->enable_perf_counters)
+                {
+                        perf_counters_init(&p_run->perf_counters);
+                }
+                phase_timer_init(&p_run->phase_timer, p_settings->enable_phase_timing,
+                                 p_settings->enable_perf_counters ? &p_run->perf_counters : NULL);
+        }
+
+        *pp_runs = p_runs;
+        *p_nb_runs = nb_runs;
 }
 
-static void print_results_csv(int rep, double timing_in_seconds, int check_status)
+static void delete_engine_runs(struct s_engine_run **pp_runs, int nb_runs, struct s_settings *p_settings)
 {
-        printf("%d,%le,%d", rep, timing_in_seconds, check_status);
+        assert(*pp_runs != NULL);
+        int e;
+        for (e = 0; e < nb_runs; e++)
+        {
+                if (p_settings->enable_perf_counters)
+                {
+                        perf_counters_delete(&(*pp_runs)[e].perf_counters);
+                }
+                if ((*pp_runs)[e].p_context != NULL)
+                {
+                        histogram_context_delete(&(*pp_runs)[e].p_context);
+                }
+                if ((*pp_runs)[e].p_window != NULL)
+                {
+                        histogram_window_delete(&(*pp_runs)[e].p_window);
+                }
+                int k;
+                for (k = 1; k < p_settings->nb_specs; k++)
+                {
+                        free((*pp_runs)[e].extra_histograms[k]);
+                }
+                bench_samples_delete(&(*pp_runs)[e].samples);
+        }
+        free(*pp_runs);
+        *pp_runs = NULL;
 }
 
-static void print_csv_header(void)
+static void context_compute_histogram(struct s_histogram_context *p_context, const ELEMENT_TYPE *array, int *histogram, struct s_settings *p_settings)
 {
-        print_settings_csv_header();
-        printf(",");
-        print_results_csv_header();
-        printf("\n");
+        const size_t array_len = p_settings->array_len;
+        const size_t chunk_len = (p_settings->chunk_len > 0) ? (size_t)p_settings->chunk_len : array_len;
+
+        histogram_context_reset(p_context);
+        size_t offset;
+        for (offset = 0; offset < array_len; offset += chunk_len)
+        {
+                size_t len = (array_len - offset < chunk_len) ? array_len - offset : chunk_len;
+                histogram_context_add(p_context, array + offset, len);
+        }
+
+        const uint64_t *counts = histogram_context_counts(p_context);
+        int j;
+        for (j = 0; j < p_settings->nb_bins; j++)
+        {
+                histogram[j] = (int)counts[j];
+        }
 }
 
-static void naive_compute_histogram(const ELEMENT_TYPE *array, int *histogram, struct s_settings *p_settings)
+static void window_compute_histogram(struct s_histogram_window *p_window, const ELEMENT_TYPE *array, int *histogram, struct s_settings *p_settings)
 {
-        memset(histogram, 0, p_settings->nb_bins * sizeof(*histogram));
+        const size_t array_len = p_settings->array_len;
+        const size_t chunk_len = (p_settings->chunk_len > 0) ? (size_t)p_settings->chunk_len : array_len;
 
-        ELEMENT_TYPE *bounds = NULL;
-        bounds = malloc((p_settings->nb_bins + 1) * sizeof(*bounds));
-        if (bounds == NULL)
+        histogram_window_reset(p_window);
+        size_t offset;
+        for (offset = 0; offset < array_len; offset += chunk_len)
         {
-                PRINT_ERROR("memory allocation failed");
+                size_t len = (array_len - offset < chunk_len) ? array_len - offset : chunk_len;
+                histogram_window_push_block(p_window, array + offset, len);
         }
 
+        const uint32_t *counts = histogram_window_counts(p_window);
+        int j;
+        for (j = 0; j < p_settings->nb_bins; j++)
         {
-                const ELEMENT_TYPE offset = p_settings->lower_bound;
-                const ELEMENT_TYPE scale = p_settings->upper_bound - p_settings->lower_bound;
+                histogram[j] = (int)counts[j];
+        }
+}
 
-                bounds[0] = offset;
+/* histogram k of the multi engines lands in extra_histograms[k], the main spec in histogram */
+static void multi_compute_histogram(struct s_engine_run *p_run, const ELEMENT_TYPE *array, int *histogram, struct s_settings *p_settings)
+{
+        int *histograms[MAX_SPECS];
+        histograms[0] = histogram;
+        int k;
+        for (k = 1; k < p_settings->nb_specs; k++)
+        {
+                histograms[k] = p_run->extra_histograms[k];
+        }
 
-                int j;
-                for (j = 0; j < p_settings->nb_bins; j++)
+        if (p_run->p_engine == &multi_engine)
+        {
+                omp_compute_multi_histogram(array, p_settings->array_len, histograms, p_settings->specs, p_settings->nb_specs);
+        }
+        else
+        {
+                for (k = 0; k < p_settings->nb_specs; k++)
                 {
-                        bounds[j + 1] = offset + (j + 1) * scale / p_settings->nb_bins;
+                        omp_compute_histogram(array, p_settings->array_len, histograms[k], &p_settings->specs[k]);
                 }
         }
+}
 
-        int i;
-        for (i = 0; i < p_settings->array_len; i++)
+/* number of trailing array elements an engine result covers: the window engine only holds the last window_len */
+static int engine_run_len(const struct s_engine_run *p_run, struct s_settings *p_settings)
+{
+        if (p_run->p_window != NULL)
         {
-                ELEMENT_TYPE value = array[i];
+                return histogram_window_fill(p_run->p_window);
+        }
+        return p_settings->array_len;
+}
 
-                int j;
-                for (j = 0; j < p_settings->nb_bins; j++)
-                {
-                        if (value >= bounds[j] && value < bounds[j + 1])
-                        {
-                                histogram[j]++;
-                                break;
-                        }
-                }
+/* integer samples through the variant of p_engine for their width */
+static void compute_int_histogram(const struct s_histogram_engine *p_engine, const void *int_array, int array_len, int *histogram,
+                                  struct s_settings *p_settings)
+{
+        switch (p_settings->input_type)
+        {
+        case input_u8:
+                p_engine->compute_u8(int_array, array_len, histogram, &p_settings->spec);
+                break;
+        case input_u16:
+                p_engine->compute_u16(int_array, array_len, histogram, &p_settings->spec);
+                break;
+        default:
+                p_engine->compute_u32(int_array, array_len, histogram, &p_settings->spec);
+                break;
         }
+}
 
-        free(bounds);
+/* run_histogram[_<engine>].csv, or run_histogram_{2d,weighted,int}[...].csv */
+static const char *output_basename(struct s_settings *p_settings)
+{
+        if (p_settings->enable_2d)
+        {
+                return "run_histogram_2d";
+        }
+        if (p_settings->input_type != input_float)
+        {
+                return "run_histogram_int";
+        }
+        return (p_settings->weights != weights_none) ? "run_histogram_weighted" : "run_histogram";
 }
 
-static void run(const ELEMENT_TYPE *array, int *run_histogram, struct s_settings *p_settings)
+static void run(struct s_engine_run *p_run, const struct s_input *p_input, const struct s_histogram_bins *p_bins, struct s_histogram_index *p_index, struct s_phase_timer *p_timer, struct s_settings *p_settings)
 {
-        naive_compute_histogram(array, run_histogram, p_settings);
+        const struct s_histogram_engine *p_engine = p_run->p_engine;
+        const ELEMENT_TYPE *array = p_input->array;
+        int *run_histogram = p_bins->counts;
+
+        phase_timer_begin(p_timer, phase_kernel);
+        if (p_settings->enable_2d)
+        {
+                p_engine->compute_2d(array, p_input->y_array, p_settings->array_len, run_histogram, &p_settings->spec_2d);
+        }
+        else if (p_settings->weights == weights_double)
+        {
+                p_engine->compute_weighted(array, p_input->double_weights, p_settings->array_len, p_bins->sums, &p_settings->spec);
+        }
+        else if (p_settings->weights != weights_none)
+        {
+                p_engine->compute_weighted_u64(array, p_input->u64_weights, p_settings->array_len, p_bins->u64_counts, &p_settings->spec);
+        }
+        else if (p_engine == &float_engine)
+        {
+                omp_compute_histogram(array, p_settings->array_len, run_histogram, &p_settings->spec);
+        }
+        else if (p_settings->input_type != input_float)
+        {
+                compute_int_histogram(p_engine, p_input->int_array, p_settings->array_len, run_histogram, p_settings);
+        }
+        else if (p_run->p_context != NULL)
+        {
+                context_compute_histogram(p_run->p_context, array, run_histogram, p_settings);
+        }
+        else if (p_run->p_window != NULL)
+        {
+                window_compute_histogram(p_run->p_window, array, run_histogram, p_settings);
+        }
+        else if (p_engine == &multi_engine || p_engine == &omp_each_engine)
+        {
+                multi_compute_histogram(p_run, array, run_histogram, p_settings);
+        }
+        else if (p_engine == &batch_engine)
+        {
+                omp_compute_histogram_batch(array, p_settings->batch_offsets, p_settings->batch_size, run_histogram, &p_settings->spec);
+        }
+        else
+        {
+                int b;
+                for (b = 0; b < p_settings->batch_size; b++)
+                {
+                        p_engine->compute(array + p_settings->batch_offsets[b], p_settings->array_len, run_histogram + (size_t)b * p_settings->nb_bins,
+                                          &p_settings->spec);
+                }
+        }
+        phase_timer_end(p_timer, phase_kernel);
 
+        phase_timer_begin(p_timer, phase_output);
         if (p_settings->enable_output)
         {
-                FILE *file = fopen("run_histogram.csv", "w");
+                char filename[64];
+                if (p_settings->p_engine != NULL)
+                {
+                        snprintf(filename, 64, "%s.csv", output_basename(p_settings));
+                }
+                else
+                {
+                        snprintf(filename, 64, "%s_%s.csv", output_basename(p_settings), p_engine->name);
+                }
+                FILE *file = fopen(filename, "w");
                 if (file == NULL)
                 {
                         perror("fopen");
                         exit(EXIT_FAILURE);
                 }
-                write_histogram_to_file(file, run_histogram, p_settings);
+                write_histogram_to_file(file, p_bins, p_settings);
                 fclose(file);
+
+                /* the binary format holds one-dimensional int histograms */
+                if (run_histogram != NULL && !p_settings->enable_2d)
+                {
+                        if (p_settings->p_engine != NULL)
+                        {
+                                snprintf(filename, 64, "run_histogram.hist");
+                        }
+                        else
+                        {
+                                snprintf(filename, 64, "run_histogram_%s.hist", p_engine->name);
+                        }
+                        const int run_len = engine_run_len(p_run, p_settings);
+                        write_histogram_binary(filename, run_histogram, array + (p_settings->array_len - run_len), run_len, p_settings);
+                }
         }
 
         if (p_settings->enable_verbose)
         {
-                printf("run histogram:\n");
-                print_histogram(run_histogram, p_settings);
+                printf("run histogram (%s):\n", p_engine->name);
+                print_histogram(p_bins, p_settings);
                 printf("\n\n");
         }
+
+        if (p_settings->nb_quantiles > 0)
+        {
+                histogram_index_build_int(p_index, run_histogram);
+                int q;
+                for (q = 0; q < p_settings->nb_quantiles; q++)
+                {
+                        p_run->quantiles[q] = histogram_index_quantile(p_index, p_settings->quantiles[q]);
+                        if (p_settings->enable_verbose)
+                        {
+                                printf("quantile %g (%s): %lg\n", p_settings->quantiles[q], p_engine->name, p_run->quantiles[q]);
+                        }
+                }
+        }
+        phase_timer_end(p_timer, phase_output);
+}
+
+/* the naive engine's histogram of the array_len elements starting at element offset */
+static void compute_check_histogram(const struct s_input *p_input, size_t offset, int array_len, const struct s_histogram_bins *p_check_bins,
+                                    struct s_settings *p_settings)
+{
+        const ELEMENT_TYPE *array = p_input->array + offset;
+        if (p_settings->enable_2d)
+        {
+                naive_compute_histogram_2d(array, p_input->y_array + offset, array_len, p_check_bins->counts, &p_settings->spec_2d);
+        }
+        else if (p_settings->weights == weights_double)
+        {
+                naive_compute_weighted_histogram(array, p_input->double_weights + offset, array_len, p_check_bins->sums, &p_settings->spec);
+        }
+        else if (p_settings->weights != weights_none)
+        {
+                const uint64_t *u64_weights = (p_input->u64_weights != NULL) ? p_input->u64_weights + offset : NULL;
+                naive_compute_weighted_histogram_u64(array, u64_weights, array_len, p_check_bins->u64_counts, &p_settings->spec);
+        }
+        else if (p_settings->input_type == input_u8)
+        {
+                naive_compute_histogram_u8((const uint8_t *)p_input->int_array + offset, array_len, p_check_bins->counts, &p_settings->spec);
+        }
+        else if (p_settings->input_type == input_u16)
+        {
+                naive_compute_histogram_u16((const uint16_t *)p_input->int_array + offset, array_len, p_check_bins->counts, &p_settings->spec);
+        }
+        else if (p_settings->input_type == input_u32)
+        {
+                naive_compute_histogram_u32((const uint32_t *)p_input->int_array + offset, array_len, p_check_bins->counts, &p_settings->spec);
+        }
+        else
+        {
+                naive_compute_histogram(array, array_len, p_check_bins->counts, &p_settings->spec);
+        }
+}
+
+/* 64-bit counts must match exactly, compensated sums up to their last rounding */
+static int check_weighted(const struct s_histogram_bins *p_check_bins, const struct s_histogram_bins *p_run_bins, struct s_settings *p_settings)
+{
+        int check = 0;
+        int j;
+        for (j = 0; j < p_settings->nb_bins; j++)
+        {
+                if (p_settings->weights == weights_double)
+                {
+                        double error = fabs(p_run_bins->sums[j] - p_check_bins->sums[j]);
+                        if (error > CHECK_RELATIVE_TOLERANCE * fabs(p_check_bins->sums[j]))
+                        {
+                                fprintf(stderr, "check failed [bin: %d]: run = %.17g, check = %.17g\n", j, p_run_bins->sums[j],
+                                        p_check_bins->sums[j]);
+                                check = 1;
+                        }
+                }
+                else if (p_run_bins->u64_counts[j] != p_check_bins->u64_counts[j])
+                {
+                        fprintf(stderr, "check failed [bin: %d]: run = %llu, check = %llu\n", j, (unsigned long long)p_run_bins->u64_counts[j],
+                                (unsigned long long)p_check_bins->u64_counts[j]);
+                        check = 1;
+                }
+        }
+        return check;
 }
 
-static int check(const ELEMENT_TYPE *array, int *check_histogram, const int *run_histogram, struct s_settings *p_settings)
+static int check(const struct s_input *p_input, int array_len, const struct s_histogram_bins *p_check_bins, const struct s_histogram_bins *p_run_bins,
+                 struct s_settings *p_settings)
 {
-        naive_compute_histogram(array, check_histogram, p_settings);
+        /* the window engine only covers the last array_len elements */
+        compute_check_histogram(p_input, p_settings->array_len - array_len, array_len, p_check_bins, p_settings);
 
         if (p_settings->enable_output)
         {
@@ -437,27 +1728,75 @@ static int check(const ELEMENT_TYPE *array, int *check_histogram, const int *run
                         perror("fopen");
                         exit(EXIT_FAILURE);
                 }
-                write_histogram_to_file(file, check_histogram, p_settings);
+                write_histogram_to_file(file, p_check_bins, p_settings);
                 fclose(file);
         }
 
         if (p_settings->enable_verbose)
         {
                 printf("check histogram:\n");
-                print_histogram(check_histogram, p_settings);
+                print_histogram(p_check_bins, p_settings);
                 printf("\n\n");
         }
 
+        if (p_settings->weights != weights_none)
+        {
+                return check_weighted(p_check_bins, p_run_bins, p_settings);
+        }
+
+        const int *check_histogram = p_check_bins->counts;
         int check = 0;
-        int i;
-        for (i = 0; i < p_settings->nb_bins; i++)
+        int b;
+        for (b = 0; b < p_settings->batch_size; b++)
         {
-                if (run_histogram[i] != check_histogram[i])
+                /* the first array's check histogram is the one written or shown above */
+                if (b > 0)
                 {
-                        fprintf(stderr, "check failed [bin: %d]: run = %d, check = %d\n", i,
-                                run_histogram[i], check_histogram[i]);
-                        check = 1;
+                        compute_check_histogram(p_input, p_settings->batch_offsets[b], array_len, p_check_bins, p_settings);
+                }
+
+                const int *batch_run_histogram = p_run_bins->counts + (size_t)b * p_settings->nb_cells;
+                int i;
+                for (i = 0; i < p_settings->nb_cells; i++)
+                {
+                        if (batch_run_histogram[i] != check_histogram[i])
+                        {
+                                fprintf(stderr, "check failed [array: %d, bin: %d]: run = %d, check = %d\n", b, i,
+                                        batch_run_histogram[i], check_histogram[i]);
+                                check = 1;
+                        }
+                }
+        }
+        return check;
+}
+
+/* extra specs of the multi engines, each against its own naive histogram */
+static int check_extra_specs(const ELEMENT_TYPE *array, const struct s_engine_run *p_run, struct s_settings *p_settings)
+{
+        int check = 0;
+        int k;
+        for (k = 1; k < p_settings->nb_specs; k++)
+        {
+                const struct s_histogram_spec *p_spec = &p_settings->specs[k];
+                const int *run_histogram = p_run->extra_histograms[k];
+                int *check_histogram = calloc(p_spec->nb_bins, sizeof(*check_histogram));
+                if (check_histogram == NULL)
+                {
+                        PRINT_ERROR("memory allocation failed");
+                }
+                naive_compute_histogram(array, p_settings->array_len, check_histogram, p_spec);
+
+                int i;
+                for (i = 0; i < p_spec->nb_bins; i++)
+                {
+                        if (run_histogram[i] != check_histogram[i])
+                        {
+                                fprintf(stderr, "check failed [spec: %d, bin: %d]: run = %d, check = %d\n", k, i,
+                                        run_histogram[i], check_histogram[i]);
+                                check = 1;
+                        }
                 }
+                free(check_histogram);
         }
         return check;
 }
@@ -469,85 +1808,228 @@ int main(int argc, char *argv[])
         init_settings(&p_settings);
         parse_cmd_line(argc, argv, p_settings);
 
-        ELEMENT_TYPE *array = NULL;
-        allocate_array(&array, p_settings);
+        if (p_settings->enable_pinning)
+        {
+                bench_pin_threads();
+        }
+
+        struct s_engine_run *p_runs = NULL;
+        int nb_runs = 0;
+        init_engine_runs(&p_runs, &nb_runs, p_settings);
 
-        int *histogram = NULL;
-        allocate_histogram(&histogram, p_settings);
+        /* allocation, data generation and array output are shared by all engines */
+        struct s_phase_timer shared_timer;
+        phase_timer_init(&shared_timer, p_settings->enable_phase_timing, NULL);
 
-        int *check_histogram = NULL;
-        allocate_histogram(&check_histogram, p_settings);
+        phase_timer_begin(&shared_timer, phase_alloc);
+        struct s_input input = {0};
+        allocate_input(&input, p_settings);
 
+        struct s_histogram_bins bins = {0};
+        allocate_bins(&bins, p_settings->nb_cells * p_settings->batch_size, p_settings);
+
+        struct s_histogram_bins check_bins = {0};
+        allocate_bins(&check_bins, p_settings->nb_cells, p_settings);
+
+        struct s_histogram_index *p_index = NULL;
+        if (p_settings->nb_quantiles > 0 && histogram_index_init(&p_index, &p_settings->spec) != 0)
         {
-                if (!p_settings->enable_verbose)
+                PRINT_ERROR("histogram index initialization failed");
+        }
+
+        int e;
+        for (e = 0; e < nb_runs; e++)
+        {
+                if (p_runs[e].p_engine == &context_engine)
+                {
+                        if (histogram_context_init(&p_runs[e].p_context, &p_settings->spec, 0) != 0)
+                        {
+                                PRINT_ERROR("histogram context initialization failed");
+                        }
+                }
+                else if (p_runs[e].p_engine == &window_engine)
+                {
+                        if (histogram_window_init(&p_runs[e].p_window, &p_settings->spec, p_settings->window_len) != 0)
+                        {
+                                PRINT_ERROR("histogram window initialization failed");
+                        }
+                }
+                else if (p_runs[e].p_engine == &multi_engine || p_runs[e].p_engine == &omp_each_engine)
                 {
-                        print_csv_header();
+                        int k;
+                        for (k = 1; k < p_settings->nb_specs; k++)
+                        {
+                                allocate_histogram(&p_runs[e].extra_histograms[k], p_settings->specs[k].nb_bins);
+                        }
                 }
+        }
+        phase_timer_end(&shared_timer, phase_alloc);
 
-                if (p_settings->enable_output)
+        {
+                if (!p_settings->enable_verbose)
                 {
-                        FILE *file = fopen("bins.csv", "w");
-                        if (file == NULL)
+                        if (p_settings->enable_summary)
                         {
-                                perror("fopen");
-                                exit(EXIT_FAILURE);
+                                print_summary_csv_header(p_settings);
                         }
-                        write_bins_to_file(file, p_settings);
-                        fclose(file);
+                        else
+                        {
+                                print_csv_header(p_settings);
+                        }
+                }
+
+                if (p_settings->enable_output && p_settings->enable_2d)
+                {
+                        write_bins_to_file("x_bins.csv", &p_settings->spec_2d.x);
+                        write_bins_to_file("y_bins.csv", &p_settings->spec_2d.y);
+                }
+                else if (p_settings->enable_output)
+                {
+                        write_bins_to_file("bins.csv", &p_settings->spec);
                 }
 
-                int rep;
-                for (rep = 0; rep < p_settings->nb_repeat; rep++)
+                double measured_time = 0.0;
+                int iter;
+                for (iter = 0; iter < p_settings->nb_warmup + p_settings->nb_repeat || measured_time < p_settings->min_time; iter++)
                 {
+                        const int is_warmup = iter < p_settings->nb_warmup;
+                        const int rep = iter - p_settings->nb_warmup;
+
                         if (p_settings->enable_verbose)
                         {
-                                printf("repeat %d\n", rep);
+                                if (is_warmup)
+                                {
+                                        printf("warmup %d\n", iter);
+                                }
+                                else
+                                {
+                                        printf("repeat %d\n", rep);
+                                }
                         }
 
-                        init_array_random(array, p_settings);
+                        phase_timer_reset(&shared_timer);
 
+                        phase_timer_begin(&shared_timer, phase_init);
+                        init_input_random(&input, p_settings);
+                        phase_timer_end(&shared_timer, phase_init);
+
+                        phase_timer_begin(&shared_timer, phase_output);
                         if (p_settings->enable_output)
                         {
-                                FILE *file = fopen("array.csv", "w");
+                                FILE *file = fopen(p_settings->enable_2d ? "array_2d.csv" : "array.csv", "w");
                                 if (file == NULL)
                                 {
                                         perror("fopen");
                                         exit(EXIT_FAILURE);
                                 }
-                                write_array_to_file(file, array, p_settings);
+                                write_input_to_file(file, &input, p_settings);
                                 fclose(file);
                         }
 
                         if (p_settings->enable_verbose)
                         {
                                 printf("array:\n");
-                                print_array(array, p_settings);
+                                print_array(input.array, p_settings);
                                 printf("\n\n");
+                                if (input.y_array != NULL)
+                                {
+                                        printf("y array:\n");
+                                        print_array(input.y_array, p_settings);
+                                        printf("\n\n");
+                                }
                         }
+                        phase_timer_end(&shared_timer, phase_output);
+
+                        for (e = 0; e < nb_runs; e++)
+                        {
+                                struct s_engine_run *p_run = &p_runs[e];
+                                struct s_phase_timer *p_timer = &p_run->phase_timer;
+
+                                phase_timer_reset(p_timer);
+                                phase_timer_add(p_timer, phase_alloc, (iter == 0) ? shared_timer.elapsed[phase_alloc] : 0.0);
+                                phase_timer_add(p_timer, phase_init, shared_timer.elapsed[phase_init]);
+                                phase_timer_add(p_timer, phase_output, shared_timer.elapsed[phase_output]);
+
+                                run(p_run, &input, &bins, p_index, p_timer, p_settings);
+                                double timing_in_seconds = p_timer->elapsed[phase_kernel];
+
+                                if (is_warmup)
+                                {
+                                        continue;
+                                }
+
+                                bench_samples_add(&p_run->samples, timing_in_seconds);
+                                p_run->measured_time += timing_in_seconds;
+
+                                phase_timer_begin(p_timer, phase_check);
+                                const int check_len = engine_run_len(p_run, p_settings);
+                                int check_status = check(&input, check_len, &check_bins, &bins, p_settings);
+                                if (p_run->extra_histograms[1] != NULL)
+                                {
+                                        check_status |= check_extra_specs(input.array, p_run, p_settings);
+                                }
+                                phase_timer_end(p_timer, phase_check);
+
+                                phase_timer_collect(p_timer);
+
+                                if (p_settings->enable_summary)
+                                {
+                                        p_run->check_status |= check_status;
+                                        continue;
+                                }
 
-                        struct timespec timing_start, timing_end;
-                        clock_gettime(CLOCK_MONOTONIC, &timing_start);
-                        run(array, histogram, p_settings);
-                        clock_gettime(CLOCK_MONOTONIC, &timing_end);
-                        double timing_in_seconds = (timing_end.tv_sec - timing_start.tv_sec) + 1.0e-9 * (timing_end.tv_nsec - timing_start.tv_nsec);
+                                if (p_settings->enable_verbose)
+                                {
+                                        print_csv_header(p_settings);
+                                }
+                                print_settings_csv(p_run->p_engine, p_settings);
+                                printf(",");
+                                print_results_csv(rep, timing_in_seconds, check_status);
+                                if (p_settings->enable_phase_timing)
+                                {
+                                        printf(",");
+                                        phase_timer_print_csv(p_timer);
+                                }
+                                if (p_settings->enable_perf_counters)
+                                {
+                                        printf(",");
+                                        perf_counters_print_last_csv(&p_run->perf_counters);
+                                }
+                                print_quantiles_csv(p_run, p_settings);
+                                printf("\n");
+                        }
 
-                        int check_status = check(array, check_histogram, histogram, p_settings);
+                        /* --min-time applies to the engine with the least measured time */
+                        measured_time = p_runs[0].measured_time;
+                        for (e = 1; e < nb_runs; e++)
+                        {
+                                if (p_runs[e].measured_time < measured_time)
+                                {
+                                        measured_time = p_runs[e].measured_time;
+                                }
+                        }
+                }
 
+                if (p_settings->enable_summary)
+                {
                         if (p_settings->enable_verbose)
                         {
-                                print_csv_header();
+                                print_summary_csv_header(p_settings);
+                        }
+                        for (e = 0; e < nb_runs; e++)
+                        {
+                                print_summary_csv(&p_runs[e], p_settings);
                         }
-                        print_settings_csv(p_settings);
-                        printf(",");
-                        print_results_csv(rep, timing_in_seconds, check_status);
-                        printf("\n");
                 }
         }
 
-        delete_histogram(&check_histogram);
-        delete_histogram(&histogram);
+        delete_engine_runs(&p_runs, nb_runs, p_settings);
+
+        histogram_index_delete(&p_index);
+        delete_bins(&check_bins);
+        delete_bins(&bins);
 
-        delete_array(&array);
+        delete_input(&input);
         delete_settings(&p_settings);
 
         return 0;
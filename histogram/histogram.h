@@ -0,0 +1,106 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "histogram_engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Reusable histogram context: the bin specification, the thread count and
+ * every buffer needed for counting are set up once by histogram_context_init(),
+ * so histogram_context_add() can be called any number of times, on whole arrays
+ * or on chunks of a stream, without allocating. Counts are 64-bit and keep
+ * accumulating until histogram_context_reset().
+ *
+ * A context is not thread-safe: feed it from one thread at a time (it uses an
+ * OpenMP team internally) and merge per-thread or per-shard contexts instead.
+ */
+struct s_histogram_context;
+
+int histogram_context_init(struct s_histogram_context **pp_context, const struct s_histogram_spec *p_spec, int nb_threads);
+void histogram_context_delete(struct s_histogram_context **pp_context);
+
+void histogram_context_reset(struct s_histogram_context *p_context);
+void histogram_context_add(struct s_histogram_context *p_context, const ELEMENT_TYPE *array, size_t array_len);
+int histogram_context_merge(struct s_histogram_context *p_dst_context, const struct s_histogram_context *p_src_context);
+
+const struct s_histogram_spec *histogram_context_spec(const struct s_histogram_context *p_context);
+const uint64_t *histogram_context_counts(const struct s_histogram_context *p_context);
+uint64_t histogram_context_underflow(const struct s_histogram_context *p_context);
+uint64_t histogram_context_overflow(const struct s_histogram_context *p_context);
+uint64_t histogram_context_total(const struct s_histogram_context *p_context);
+
+/*
+ * Sliding-window histogram over the last window_len samples. A ring buffer
+ * keeps the slot of every sample still in the window, so each new sample
+ * increments its bin and decrements the bin of the sample it evicts: O(1) per
+ * sample whatever the window length. Counts cover min(pushed, window_len)
+ * samples; underflow/overflow are tracked like in the context.
+ */
+struct s_histogram_window;
+
+int histogram_window_init(struct s_histogram_window **pp_window, const struct s_histogram_spec *p_spec, size_t window_len);
+void histogram_window_delete(struct s_histogram_window **pp_window);
+
+void histogram_window_reset(struct s_histogram_window *p_window);
+void histogram_window_push(struct s_histogram_window *p_window, ELEMENT_TYPE value);
+void histogram_window_push_block(struct s_histogram_window *p_window, const ELEMENT_TYPE *array, size_t array_len);
+
+size_t histogram_window_len(const struct s_histogram_window *p_window);
+size_t histogram_window_fill(const struct s_histogram_window *p_window);
+const uint32_t *histogram_window_counts(const struct s_histogram_window *p_window);
+uint32_t histogram_window_underflow(const struct s_histogram_window *p_window);
+uint32_t histogram_window_overflow(const struct s_histogram_window *p_window);
+
+/*
+ * Cumulative index over a computed histogram, kept as a Fenwick tree so that
+ * it can still be updated bin by bin: prefix and range counts and quantiles
+ * all cost O(log nb_bins), instead of a scan of the bins per query. Quantiles
+ * interpolate linearly inside the selected bin and are NaN on an empty index.
+ */
+struct s_histogram_index;
+
+int histogram_index_init(struct s_histogram_index **pp_index, const struct s_histogram_spec *p_spec);
+void histogram_index_delete(struct s_histogram_index **pp_index);
+
+void histogram_index_build(struct s_histogram_index *p_index, const uint64_t *counts);
+void histogram_index_build_int(struct s_histogram_index *p_index, const int *counts);
+void histogram_index_update(struct s_histogram_index *p_index, int bin, int64_t delta);
+
+uint64_t histogram_index_total(const struct s_histogram_index *p_index);
+uint64_t histogram_index_prefix_count(const struct s_histogram_index *p_index, int nb_first_bins);
+uint64_t histogram_index_bin_range_count(const struct s_histogram_index *p_index, int first_bin, int last_bin);
+uint64_t histogram_index_range_count(const struct s_histogram_index *p_index, double lower_value, double upper_value);
+int histogram_index_quantile_bin(const struct s_histogram_index *p_index, double q);
+double histogram_index_quantile(const struct s_histogram_index *p_index, double q);
+
+/*
+ * Mergeable binary format: a fixed little-endian header (magic, version,
+ * spec, 64-bit total, underflow and overflow) followed by the bin counts as
+ * zigzag varints of their difference with the previous bin, so that smooth
+ * or sparse histograms take about a byte per bin. Counts arrays have
+ * nb_bins + 2 slots, underflow and overflow last, like the context's.
+ * Decoding adds into the counts, so many shards are merged without a copy;
+ * it returns -1 on a corrupted buffer or a spec mismatch.
+ */
+#define HISTOGRAM_FORMAT_VERSION 1
+
+size_t histogram_encoded_size_bound(const struct s_histogram_spec *p_spec);
+size_t histogram_encode(const struct s_histogram_spec *p_spec, const uint64_t *counts, uint8_t *buffer);
+int histogram_decode_spec(const uint8_t *buffer, size_t buffer_size, struct s_histogram_spec *p_spec);
+int histogram_decode_add(const uint8_t *buffer, size_t buffer_size, const struct s_histogram_spec *p_spec, uint64_t *counts);
+
+int histogram_write_file(const char *filename, const struct s_histogram_spec *p_spec, const uint64_t *counts);
+int histogram_read_file(const char *filename, uint8_t **p_buffer, size_t *p_buffer_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
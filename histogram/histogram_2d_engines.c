@@ -0,0 +1,92 @@
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "histogram_engine.h"
+
+/* up to this many cells (1 MiB of counts) every thread keeps a private grid */
+#define PRIVATE_GRID_MAX_CELLS (1 << 18)
+
+void naive_compute_histogram_2d(const ELEMENT_TYPE *x_array, const ELEMENT_TYPE *y_array, int array_len, int *histogram,
+                                const struct s_histogram_2d_spec *p_spec)
+{
+        const int nb_cells = p_spec->x.nb_bins * p_spec->y.nb_bins;
+        const struct s_histogram_binning x_binning = histogram_binning(&p_spec->x);
+        const struct s_histogram_binning y_binning = histogram_binning(&p_spec->y);
+
+        memset(histogram, 0, nb_cells * sizeof(*histogram));
+
+        int i;
+        for (i = 0; i < array_len; i++)
+        {
+                int j = histogram_2d_cell_index(&x_binning, &y_binning, x_array[i], y_array[i]);
+                if (j >= 0)
+                {
+                        histogram[j]++;
+                }
+        }
+}
+
+/*
+ * Small grids: per-thread private grids reduced cell by cell, as in the 1D
+ * engine. Large grids would multiply the footprint by the thread count and
+ * spill out of cache, and a shared grid would take one atomic per pair,
+ * so pairs are partitioned by cell range first instead, each range then
+ * counted by one thread on its cache-resident slice of the grid.
+ */
+void omp_compute_histogram_2d(const ELEMENT_TYPE *x_array, const ELEMENT_TYPE *y_array, int array_len, int *histogram,
+                              const struct s_histogram_2d_spec *p_spec)
+{
+        const int nb_cells = p_spec->x.nb_bins * p_spec->y.nb_bins;
+
+        if (nb_cells > PRIVATE_GRID_MAX_CELLS)
+        {
+                radix_compute_histogram_2d(x_array, y_array, array_len, histogram, p_spec);
+                return;
+        }
+
+        const struct s_histogram_binning x_binning = histogram_binning(&p_spec->x);
+        const struct s_histogram_binning y_binning = histogram_binning(&p_spec->y);
+
+        memset(histogram, 0, nb_cells * sizeof(*histogram));
+
+        const int nb_threads = omp_get_max_threads();
+        const int stride = histogram_padded_stride(nb_cells, sizeof(int));
+        int *partial_histograms = calloc((size_t)nb_threads * stride, sizeof(*partial_histograms));
+        if (partial_histograms == NULL)
+        {
+                PRINT_ERROR("memory allocation failed for partial histograms");
+        }
+
+#pragma omp parallel num_threads(nb_threads)
+        {
+                int *my_histogram = partial_histograms + (size_t)omp_get_thread_num() * stride;
+
+                int i;
+#pragma omp for schedule(static)
+                for (i = 0; i < array_len; i++)
+                {
+                        int j = histogram_2d_cell_index(&x_binning, &y_binning, x_array[i], y_array[i]);
+                        if (j >= 0)
+                        {
+                                my_histogram[j]++;
+                        }
+                }
+
+                int j;
+#pragma omp for schedule(static)
+                for (j = 0; j < nb_cells; j++)
+                {
+                        int sum = 0;
+                        int t;
+                        for (t = 0; t < nb_threads; t++)
+                        {
+                                sum += partial_histograms[(size_t)t * stride + j];
+                        }
+                        histogram[j] = sum;
+                }
+        }
+
+        free(partial_histograms);
+}
@@ -0,0 +1,43 @@
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "histogram_engine.h"
+
+/* from about 10^6 elements, splitting one array across threads pays (perf/omp_scaling_data.csv) */
+#define BATCH_SPLIT_MIN_LEN (1 << 20)
+
+/*
+ * Small arrays are too short to split across threads: forking, partials
+ * and their reduction cost more than the counting itself. Each array is
+ * instead counted whole by one thread, straight into its own histogram,
+ * and threads take arrays from a shared queue so that uneven lengths
+ * balance out. Arrays long enough to split go through the omp engine,
+ * one after the other, with every thread on each.
+ */
+void omp_compute_histogram_batch(const ELEMENT_TYPE *array, const size_t *offsets, int nb_arrays, int *histograms,
+                                 const struct s_histogram_spec *p_spec)
+{
+        const int nb_bins = p_spec->nb_bins;
+
+        int b;
+#pragma omp parallel for schedule(dynamic, 1)
+        for (b = 0; b < nb_arrays; b++)
+        {
+                const size_t len = offsets[b + 1] - offsets[b];
+                if (len < BATCH_SPLIT_MIN_LEN)
+                {
+                        naive_compute_histogram(array + offsets[b], (int)len, histograms + (size_t)b * nb_bins, p_spec);
+                }
+        }
+
+        for (b = 0; b < nb_arrays; b++)
+        {
+                const size_t len = offsets[b + 1] - offsets[b];
+                if (len >= BATCH_SPLIT_MIN_LEN)
+                {
+                        omp_compute_histogram(array + offsets[b], (int)len, histograms + (size_t)b * nb_bins, p_spec);
+                }
+        }
+}
@@ -0,0 +1,96 @@
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "histogram_engine.h"
+
+/*
+ * Each thread counts into narrow counters, 4 or 2 times smaller than int
+ * bins, so that the hot partial histogram of a few thousand bins stays in
+ * L1/L2. A narrow counter that wraps around carries its 2^8 or 2^16 into
+ * a wide per-thread counter; that happens once every 256 or 65536 hits of
+ * the bin, so the wide counters stay out of cache without cost. The final
+ * count of a bin is the sum over threads of wide + narrow.
+ */
+static void compact_compute_histogram(const ELEMENT_TYPE *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec,
+                                      int counter_bits)
+{
+        const int nb_bins = p_spec->nb_bins;
+        const struct s_histogram_binning binning = histogram_binning(p_spec);
+        const int nb_threads = omp_get_max_threads();
+        const size_t counter_size = counter_bits / 8;
+        const int narrow_stride = histogram_padded_stride(nb_bins, counter_size);
+        const int wide_stride = histogram_padded_stride(nb_bins, sizeof(int));
+
+        void *narrow_histograms = calloc((size_t)nb_threads * narrow_stride, counter_size);
+        int *wide_histograms = calloc((size_t)nb_threads * wide_stride, sizeof(*wide_histograms));
+        if (narrow_histograms == NULL || wide_histograms == NULL)
+        {
+                PRINT_ERROR("memory allocation failed for partial histograms");
+        }
+
+#pragma omp parallel num_threads(nb_threads)
+        {
+                const int thread_id = omp_get_thread_num();
+                int *my_wide_histogram = wide_histograms + (size_t)thread_id * wide_stride;
+
+                int i;
+                if (counter_bits == 8)
+                {
+                        uint8_t *my_histogram = (uint8_t *)narrow_histograms + (size_t)thread_id * narrow_stride;
+#pragma omp for schedule(static)
+                        for (i = 0; i < array_len; i++)
+                        {
+                                int j = histogram_binning_index(&binning, array[i]);
+                                if (j >= 0 && ++my_histogram[j] == 0)
+                                {
+                                        my_wide_histogram[j] += 1 << 8;
+                                }
+                        }
+                }
+                else
+                {
+                        uint16_t *my_histogram = (uint16_t *)narrow_histograms + (size_t)thread_id * narrow_stride;
+#pragma omp for schedule(static)
+                        for (i = 0; i < array_len; i++)
+                        {
+                                int j = histogram_binning_index(&binning, array[i]);
+                                if (j >= 0 && ++my_histogram[j] == 0)
+                                {
+                                        my_wide_histogram[j] += 1 << 16;
+                                }
+                        }
+                }
+
+                int j;
+#pragma omp for schedule(static)
+                for (j = 0; j < nb_bins; j++)
+                {
+                        int sum = 0;
+                        int t;
+                        for (t = 0; t < nb_threads; t++)
+                        {
+                                const size_t narrow_j = (size_t)t * narrow_stride + j;
+                                sum += wide_histograms[(size_t)t * wide_stride + j];
+                                sum += (counter_bits == 8) ? ((const uint8_t *)narrow_histograms)[narrow_j]
+                                                           : ((const uint16_t *)narrow_histograms)[narrow_j];
+                        }
+                        histogram[j] = sum;
+                }
+        }
+
+        free(wide_histograms);
+        free(narrow_histograms);
+}
+
+void compact8_compute_histogram(const ELEMENT_TYPE *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec)
+{
+        compact_compute_histogram(array, array_len, histogram, p_spec, 8);
+}
+
+void compact16_compute_histogram(const ELEMENT_TYPE *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec)
+{
+        compact_compute_histogram(array, array_len, histogram, p_spec, 16);
+}
@@ -0,0 +1,207 @@
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "histogram.h"
+
+/* 32-bit per-thread partials are flushed into the 64-bit counts at least this often */
+#define MAX_CHUNK_LEN ((size_t)1 << 31)
+
+/* above this many slots the reduction of the partials is parallelized too */
+#define PARALLEL_REDUCTION_MIN_SLOTS 4096
+
+/* below this many elements a chunk does not pay for starting the OpenMP team */
+#define SERIAL_MAX_CHUNK_LEN 4096
+
+struct s_histogram_context
+{
+        struct s_histogram_spec spec;
+        int nb_threads;
+        int nb_slots;
+        int stride;
+        uint32_t *partial_histograms;
+        uint64_t *counts;
+};
+
+/* slots nb_bins and nb_bins + 1 count the underflow and overflow of histogram_binning_slot() */
+#define UNDERFLOW_SLOT(P_CONTEXT) ((P_CONTEXT)->spec.nb_bins)
+#define OVERFLOW_SLOT(P_CONTEXT) ((P_CONTEXT)->spec.nb_bins + 1)
+
+int histogram_context_init(struct s_histogram_context **pp_context, const struct s_histogram_spec *p_spec, int nb_threads)
+{
+        if (!histogram_spec_is_valid(p_spec))
+        {
+                return -1;
+        }
+
+        struct s_histogram_context *p_context = calloc(1, sizeof(*p_context));
+        if (p_context == NULL)
+        {
+                return -1;
+        }
+
+        p_context->spec = *p_spec;
+        p_context->nb_threads = (nb_threads > 0) ? nb_threads : omp_get_max_threads();
+        p_context->nb_slots = p_spec->nb_bins + 2;
+
+        p_context->stride = histogram_padded_stride(p_context->nb_slots, sizeof(uint32_t));
+
+        p_context->partial_histograms = aligned_alloc(HISTOGRAM_CACHE_LINE_SIZE, (size_t)p_context->nb_threads * p_context->stride * sizeof(uint32_t));
+        p_context->counts = calloc(p_context->nb_slots, sizeof(*p_context->counts));
+        if (p_context->partial_histograms == NULL || p_context->counts == NULL)
+        {
+                free(p_context->partial_histograms);
+                free(p_context->counts);
+                free(p_context);
+                return -1;
+        }
+
+        *pp_context = p_context;
+        return 0;
+}
+
+void histogram_context_delete(struct s_histogram_context **pp_context)
+{
+        struct s_histogram_context *p_context = *pp_context;
+        if (p_context == NULL)
+        {
+                return;
+        }
+        free(p_context->partial_histograms);
+        free(p_context->counts);
+        free(p_context);
+        *pp_context = NULL;
+}
+
+void histogram_context_reset(struct s_histogram_context *p_context)
+{
+        memset(p_context->counts, 0, p_context->nb_slots * sizeof(*p_context->counts));
+}
+
+/*
+ * Zeroing and reducing the partials costs O(nb_threads * nb_slots) whatever
+ * the chunk length, so small chunks, as when a stream is fed piece by
+ * piece, are counted by the calling thread straight into the counts.
+ */
+static int is_small_chunk(const struct s_histogram_context *p_context, size_t array_len)
+{
+        return p_context->nb_threads == 1 || array_len < SERIAL_MAX_CHUNK_LEN ||
+               array_len < (size_t)p_context->nb_threads * p_context->nb_slots;
+}
+
+static void add_chunk(struct s_histogram_context *p_context, const ELEMENT_TYPE *array, size_t array_len)
+{
+        const int nb_slots = p_context->nb_slots;
+        const int stride = p_context->stride;
+        const int nb_threads = p_context->nb_threads;
+        const struct s_histogram_binning binning = histogram_binning(&p_context->spec);
+        uint32_t *partial_histograms = p_context->partial_histograms;
+
+        if (is_small_chunk(p_context, array_len))
+        {
+                uint64_t *counts = p_context->counts;
+                size_t i;
+                for (i = 0; i < array_len; i++)
+                {
+                        int j = histogram_binning_slot(&binning, array[i]);
+                        if (j >= 0)
+                        {
+                                counts[j]++;
+                        }
+                }
+                return;
+        }
+
+        memset(partial_histograms, 0, (size_t)nb_threads * stride * sizeof(*partial_histograms));
+
+#pragma omp parallel num_threads(nb_threads)
+        {
+                uint32_t *my_histogram = partial_histograms + (size_t)omp_get_thread_num() * stride;
+
+                size_t i;
+#pragma omp for schedule(static)
+                for (i = 0; i < array_len; i++)
+                {
+                        int j = histogram_binning_slot(&binning, array[i]);
+                        if (j >= 0)
+                        {
+                                my_histogram[j]++;
+                        }
+                }
+        }
+
+        uint64_t *counts = p_context->counts;
+        int j;
+#pragma omp parallel for num_threads(nb_threads) if (nb_slots >= PARALLEL_REDUCTION_MIN_SLOTS)
+        for (j = 0; j < nb_slots; j++)
+        {
+                uint64_t sum = 0;
+                int t;
+                for (t = 0; t < nb_threads; t++)
+                {
+                        sum += partial_histograms[(size_t)t * stride + j];
+                }
+                counts[j] += sum;
+        }
+}
+
+void histogram_context_add(struct s_histogram_context *p_context, const ELEMENT_TYPE *array, size_t array_len)
+{
+        size_t offset;
+        for (offset = 0; offset < array_len; offset += MAX_CHUNK_LEN)
+        {
+                size_t chunk_len = array_len - offset;
+                if (chunk_len > MAX_CHUNK_LEN)
+                {
+                        chunk_len = MAX_CHUNK_LEN;
+                }
+                add_chunk(p_context, array + offset, chunk_len);
+        }
+}
+
+int histogram_context_merge(struct s_histogram_context *p_dst_context, const struct s_histogram_context *p_src_context)
+{
+        if (!histogram_spec_equal(&p_dst_context->spec, &p_src_context->spec))
+        {
+                return -1;
+        }
+
+        int j;
+        for (j = 0; j < p_dst_context->nb_slots; j++)
+        {
+                p_dst_context->counts[j] += p_src_context->counts[j];
+        }
+        return 0;
+}
+
+const struct s_histogram_spec *histogram_context_spec(const struct s_histogram_context *p_context)
+{
+        return &p_context->spec;
+}
+
+const uint64_t *histogram_context_counts(const struct s_histogram_context *p_context)
+{
+        return p_context->counts;
+}
+
+uint64_t histogram_context_underflow(const struct s_histogram_context *p_context)
+{
+        return p_context->counts[UNDERFLOW_SLOT(p_context)];
+}
+
+uint64_t histogram_context_overflow(const struct s_histogram_context *p_context)
+{
+        return p_context->counts[OVERFLOW_SLOT(p_context)];
+}
+
+uint64_t histogram_context_total(const struct s_histogram_context *p_context)
+{
+        uint64_t total = 0;
+        int j;
+        for (j = 0; j < p_context->nb_slots; j++)
+        {
+                total += p_context->counts[j];
+        }
+        return total;
+}
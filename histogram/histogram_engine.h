@@ -0,0 +1,315 @@
+#ifndef HISTOGRAM_ENGINE_H
+#define HISTOGRAM_ENGINE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define ELEMENT_TYPE float
+
+#define PRINT_ERROR(MSG)                                                    \
+        do                                                                  \
+        {                                                                   \
+                fprintf(stderr, "%s:%d - %s\n", __FILE__, __LINE__, (MSG)); \
+                exit(EXIT_FAILURE);                                         \
+        } while (0)
+
+#ifdef __CUDACC__
+#define HISTOGRAM_INLINE static inline __host__ __device__
+#else
+#define HISTOGRAM_INLINE static inline
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Per-thread partial histograms are padded to whole cache lines, so that
+ * two threads never write to the same line.
+ */
+#define HISTOGRAM_CACHE_LINE_SIZE 64
+
+/* nb_elements rounded up to whole cache lines of element_size-byte elements */
+HISTOGRAM_INLINE int histogram_padded_stride(int nb_elements, size_t element_size)
+{
+        const int elements_per_line = HISTOGRAM_CACHE_LINE_SIZE / (int)element_size;
+        return (nb_elements + elements_per_line - 1) / elements_per_line * elements_per_line;
+}
+
+enum e_histogram_scale
+{
+        histogram_scale_linear = 0,
+        histogram_scale_loglinear
+};
+
+/*
+ * linear: nb_bins equal bins over [lower_bound, upper_bound].
+ * loglinear: unbounded, 2^precision bins per power of two over every finite
+ * non-negative float, i.e. nb_bins = HISTOGRAM_LOGLINEAR_NB_BINS(precision);
+ * the bounds are not used for binning.
+ */
+struct s_histogram_spec
+{
+        int nb_bins;
+        double lower_bound;
+        double upper_bound;
+        enum e_histogram_scale scale;
+        int precision;
+};
+
+#define HISTOGRAM_MAX_PRECISION 16
+#define HISTOGRAM_LOGLINEAR_NB_BINS(PRECISION) (255 << (PRECISION))
+
+typedef void (*histogram_compute_func)(const ELEMENT_TYPE *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec);
+
+/* joint histogram of (x, y) pairs: cell (jx, jy) is at jy * x.nb_bins + jx */
+struct s_histogram_2d_spec
+{
+        struct s_histogram_spec x;
+        struct s_histogram_spec y;
+};
+
+typedef void (*histogram_2d_compute_func)(const ELEMENT_TYPE *x_array, const ELEMENT_TYPE *y_array, int array_len, int *histogram,
+                                          const struct s_histogram_2d_spec *p_spec);
+
+typedef void (*histogram_weighted_u64_compute_func)(const ELEMENT_TYPE *array, const uint64_t *weights, int array_len, uint64_t *histogram,
+                                                    const struct s_histogram_spec *p_spec);
+typedef void (*histogram_weighted_compute_func)(const ELEMENT_TYPE *array, const double *weights, int array_len, double *histogram,
+                                                const struct s_histogram_spec *p_spec);
+
+typedef void (*histogram_u8_compute_func)(const uint8_t *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec);
+typedef void (*histogram_u16_compute_func)(const uint16_t *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec);
+typedef void (*histogram_u32_compute_func)(const uint32_t *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec);
+
+/* one entry per engine, with its variant for each kind of input; NULL where it has none */
+struct s_histogram_engine
+{
+        const char *name;
+        histogram_compute_func compute;
+        histogram_2d_compute_func compute_2d;
+        histogram_weighted_u64_compute_func compute_weighted_u64;
+        histogram_weighted_compute_func compute_weighted;
+        histogram_u8_compute_func compute_u8;
+        histogram_u16_compute_func compute_u16;
+        histogram_u32_compute_func compute_u32;
+};
+
+extern const struct s_histogram_engine histogram_engines[];
+extern const int nb_histogram_engines;
+
+const struct s_histogram_engine *histogram_find_engine(const char *name);
+
+void naive_compute_histogram(const ELEMENT_TYPE *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec);
+void omp_compute_histogram(const ELEMENT_TYPE *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec);
+void sparse_compute_histogram(const ELEMENT_TYPE *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec);
+void compact8_compute_histogram(const ELEMENT_TYPE *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec);
+void compact16_compute_histogram(const ELEMENT_TYPE *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec);
+void radix_compute_histogram(const ELEMENT_TYPE *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec);
+void naive_compute_histogram_2d(const ELEMENT_TYPE *x_array, const ELEMENT_TYPE *y_array, int array_len, int *histogram,
+                                const struct s_histogram_2d_spec *p_spec);
+void omp_compute_histogram_2d(const ELEMENT_TYPE *x_array, const ELEMENT_TYPE *y_array, int array_len, int *histogram,
+                              const struct s_histogram_2d_spec *p_spec);
+void radix_compute_histogram_2d(const ELEMENT_TYPE *x_array, const ELEMENT_TYPE *y_array, int array_len, int *histogram,
+                                const struct s_histogram_2d_spec *p_spec);
+/*
+ * K histograms of the same array, one per spec, filled in a single pass:
+ * histograms[k] has specs[k].nb_bins bins.
+ */
+void omp_compute_multi_histogram(const ELEMENT_TYPE *array, int array_len, int *const *histograms, const struct s_histogram_spec *specs,
+                                 int nb_specs);
+
+/*
+ * Independent arrays, concatenated: array b is array[offsets[b]..offsets[b + 1][
+ * and its histogram is histograms[b * nb_bins..(b + 1) * nb_bins[.
+ */
+void omp_compute_histogram_batch(const ELEMENT_TYPE *array, const size_t *offsets, int nb_arrays, int *histograms,
+                                 const struct s_histogram_spec *p_spec);
+
+/*
+ * Quantized integer samples, binned as the same values converted to
+ * ELEMENT_TYPE would be, but read at their own width: through a lookup
+ * table for 8- and 16-bit samples, or a shift when bins are powers of two.
+ */
+void naive_compute_histogram_u8(const uint8_t *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec);
+void naive_compute_histogram_u16(const uint16_t *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec);
+void naive_compute_histogram_u32(const uint32_t *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec);
+void omp_compute_histogram_u8(const uint8_t *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec);
+void omp_compute_histogram_u16(const uint16_t *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec);
+void omp_compute_histogram_u32(const uint32_t *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec);
+
+/*
+ * Weighted histograms: each sample adds its weight to its bin. Integer
+ * weights go to 64-bit bins (weights == NULL counts samples, without the
+ * 2^31 limit of int bins); double weights go to double bins, accumulated
+ * with compensated summation so that the result does not depend on the
+ * number of threads beyond the last rounding.
+ */
+void naive_compute_weighted_histogram_u64(const ELEMENT_TYPE *array, const uint64_t *weights, int array_len, uint64_t *histogram,
+                                          const struct s_histogram_spec *p_spec);
+void omp_compute_weighted_histogram_u64(const ELEMENT_TYPE *array, const uint64_t *weights, int array_len, uint64_t *histogram,
+                                        const struct s_histogram_spec *p_spec);
+void naive_compute_weighted_histogram(const ELEMENT_TYPE *array, const double *weights, int array_len, double *histogram,
+                                      const struct s_histogram_spec *p_spec);
+void omp_compute_weighted_histogram(const ELEMENT_TYPE *array, const double *weights, int array_len, double *histogram,
+                                    const struct s_histogram_spec *p_spec);
+#ifdef HAVE_CUDA
+void cuda_compute_histogram(const ELEMENT_TYPE *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+HISTOGRAM_INLINE ELEMENT_TYPE histogram_inv_bin_width(const struct s_histogram_spec *p_spec)
+{
+        return (ELEMENT_TYPE)p_spec->nb_bins / ((ELEMENT_TYPE)p_spec->upper_bound - (ELEMENT_TYPE)p_spec->lower_bound);
+}
+
+/*
+ * Binning rule shared by every engine, so that their results can be compared
+ * bin for bin: bins are [lower, upper[ except the last one, which also holds
+ * upper_bound itself. Values outside [lower_bound, upper_bound] (and NaN) are
+ * dropped (-1).
+ */
+HISTOGRAM_INLINE int histogram_bin_index(ELEMENT_TYPE value, ELEMENT_TYPE lower_bound, ELEMENT_TYPE upper_bound,
+                                         ELEMENT_TYPE inv_bin_width, int nb_bins)
+{
+        if (!(value >= lower_bound && value <= upper_bound))
+        {
+                return -1;
+        }
+        int j = (int)((value - lower_bound) * inv_bin_width);
+        return (j < nb_bins) ? j : nb_bins - 1;
+}
+
+/*
+ * Log-linear rule: for a non-negative float, the exponent and the top
+ * precision bits of the mantissa are the high bits of its representation,
+ * so the bin index is a single shift. -0.0 goes with 0.0; negative values,
+ * infinity and NaN are dropped (-1).
+ */
+HISTOGRAM_INLINE int histogram_loglinear_bin_index(ELEMENT_TYPE value, int shift, int nb_bins)
+{
+        if (!(value >= 0))
+        {
+                return -1;
+        }
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        int j = (int)((bits & 0x7fffffffu) >> shift);
+        return (j < nb_bins) ? j : -1;
+}
+
+/*
+ * Same rule, but values below lower_bound map to slot nb_bins and values above
+ * upper_bound to slot nb_bins + 1, for the library's underflow/overflow counts.
+ * NaN is still dropped (-1).
+ */
+HISTOGRAM_INLINE int histogram_slot_index(ELEMENT_TYPE value, ELEMENT_TYPE lower_bound, ELEMENT_TYPE upper_bound,
+                                          ELEMENT_TYPE inv_bin_width, int nb_bins)
+{
+        if (value < lower_bound)
+        {
+                return nb_bins;
+        }
+        if (value > upper_bound)
+        {
+                return nb_bins + 1;
+        }
+        return histogram_bin_index(value, lower_bound, upper_bound, inv_bin_width, nb_bins);
+}
+
+/* everything an engine needs to bin values of either scale, derived once from the spec */
+struct s_histogram_binning
+{
+        enum e_histogram_scale scale;
+        int nb_bins;
+        int shift;
+        ELEMENT_TYPE lower_bound;
+        ELEMENT_TYPE upper_bound;
+        ELEMENT_TYPE inv_bin_width;
+};
+
+HISTOGRAM_INLINE struct s_histogram_binning histogram_binning(const struct s_histogram_spec *p_spec)
+{
+        struct s_histogram_binning binning;
+        binning.scale = p_spec->scale;
+        binning.nb_bins = p_spec->nb_bins;
+        binning.shift = 23 - p_spec->precision;
+        binning.lower_bound = p_spec->lower_bound;
+        binning.upper_bound = p_spec->upper_bound;
+        binning.inv_bin_width = (p_spec->scale == histogram_scale_linear) ? histogram_inv_bin_width(p_spec) : 0;
+        return binning;
+}
+
+/* the scale test is loop-invariant, so the compiler unswitches engine loops on it */
+HISTOGRAM_INLINE int histogram_binning_index(const struct s_histogram_binning *p_binning, ELEMENT_TYPE value)
+{
+        if (p_binning->scale == histogram_scale_loglinear)
+        {
+                return histogram_loglinear_bin_index(value, p_binning->shift, p_binning->nb_bins);
+        }
+        return histogram_bin_index(value, p_binning->lower_bound, p_binning->upper_bound, p_binning->inv_bin_width, p_binning->nb_bins);
+}
+
+/* underflow/overflow slots as in histogram_slot_index(); loglinear underflow means negative */
+HISTOGRAM_INLINE int histogram_binning_slot(const struct s_histogram_binning *p_binning, ELEMENT_TYPE value)
+{
+        if (p_binning->scale == histogram_scale_loglinear)
+        {
+                if (value < 0)
+                {
+                        return p_binning->nb_bins;
+                }
+                int j = histogram_loglinear_bin_index(value, p_binning->shift, p_binning->nb_bins);
+                return (j >= 0 || value != value) ? j : p_binning->nb_bins + 1;
+        }
+        return histogram_slot_index(value, p_binning->lower_bound, p_binning->upper_bound, p_binning->inv_bin_width, p_binning->nb_bins);
+}
+
+/* both axes are binned in the same pass; a pair is dropped if either value is */
+HISTOGRAM_INLINE int histogram_2d_cell_index(const struct s_histogram_binning *p_x_binning, const struct s_histogram_binning *p_y_binning,
+                                             ELEMENT_TYPE x, ELEMENT_TYPE y)
+{
+        int jx = histogram_binning_index(p_x_binning, x);
+        int jy = histogram_binning_index(p_y_binning, y);
+        return (jx < 0 || jy < 0) ? -1 : jy * p_x_binning->nb_bins + jx;
+}
+
+HISTOGRAM_INLINE int histogram_spec_is_valid(const struct s_histogram_spec *p_spec)
+{
+        if (p_spec->scale == histogram_scale_loglinear)
+        {
+                return p_spec->precision >= 0 && p_spec->precision <= HISTOGRAM_MAX_PRECISION &&
+                       p_spec->nb_bins == HISTOGRAM_LOGLINEAR_NB_BINS(p_spec->precision);
+        }
+        return p_spec->nb_bins >= 1 && p_spec->upper_bound > p_spec->lower_bound;
+}
+
+HISTOGRAM_INLINE int histogram_spec_equal(const struct s_histogram_spec *p_spec_a, const struct s_histogram_spec *p_spec_b)
+{
+        if (p_spec_a->scale != p_spec_b->scale || p_spec_a->nb_bins != p_spec_b->nb_bins)
+        {
+                return 0;
+        }
+        if (p_spec_a->scale == histogram_scale_loglinear)
+        {
+                return p_spec_a->precision == p_spec_b->precision;
+        }
+        return p_spec_a->lower_bound == p_spec_b->lower_bound && p_spec_a->upper_bound == p_spec_b->upper_bound;
+}
+
+/* lower edge of bin j; bin nb_bins - 1 ends at histogram_bin_edge(p_spec, nb_bins) */
+HISTOGRAM_INLINE double histogram_bin_edge(const struct s_histogram_spec *p_spec, int j)
+{
+        if (p_spec->scale == histogram_scale_loglinear)
+        {
+                uint32_t bits = (uint32_t)j << (23 - p_spec->precision);
+                float edge;
+                memcpy(&edge, &bits, sizeof(edge));
+                return edge;
+        }
+        return p_spec->lower_bound + j * (p_spec->upper_bound - p_spec->lower_bound) / p_spec->nb_bins;
+}
+
+#endif
@@ -0,0 +1,34 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "histogram_engine.h"
+
+const struct s_histogram_engine histogram_engines[] =
+    {
+        {"naive", naive_compute_histogram, naive_compute_histogram_2d, naive_compute_weighted_histogram_u64, naive_compute_weighted_histogram,
+         naive_compute_histogram_u8, naive_compute_histogram_u16, naive_compute_histogram_u32},
+        {"omp", omp_compute_histogram, omp_compute_histogram_2d, omp_compute_weighted_histogram_u64, omp_compute_weighted_histogram,
+         omp_compute_histogram_u8, omp_compute_histogram_u16, omp_compute_histogram_u32},
+        {"sparse", sparse_compute_histogram},
+        {"compact8", compact8_compute_histogram},
+        {"compact16", compact16_compute_histogram},
+        {"radix", radix_compute_histogram, radix_compute_histogram_2d},
+#ifdef HAVE_CUDA
+        {"cuda", cuda_compute_histogram},
+#endif
+};
+
+const int nb_histogram_engines = sizeof(histogram_engines) / sizeof(histogram_engines[0]);
+
+const struct s_histogram_engine *histogram_find_engine(const char *name)
+{
+        int i;
+        for (i = 0; i < nb_histogram_engines; i++)
+        {
+                if (strcmp(histogram_engines[i].name, name) == 0)
+                {
+                        return &histogram_engines[i];
+                }
+        }
+        return NULL;
+}
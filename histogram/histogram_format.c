@@ -0,0 +1,272 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "histogram.h"
+
+static const uint8_t histogram_magic[4] = {'H', 'S', 'T', 'G'};
+
+/* magic, version, scale, precision, reserved, nb_bins, bounds, total, underflow, overflow */
+#define HEADER_SIZE (4 + 4 * 1 + 4 + 2 * 8 + 3 * 8)
+#define MAX_VARINT_SIZE 10
+
+static uint8_t *put_u32(uint8_t *p, uint32_t value)
+{
+        int k;
+        for (k = 0; k < 4; k++)
+        {
+                *p++ = (uint8_t)(value >> (8 * k));
+        }
+        return p;
+}
+
+static uint8_t *put_u64(uint8_t *p, uint64_t value)
+{
+        int k;
+        for (k = 0; k < 8; k++)
+        {
+                *p++ = (uint8_t)(value >> (8 * k));
+        }
+        return p;
+}
+
+static uint8_t *put_f64(uint8_t *p, double value)
+{
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return put_u64(p, bits);
+}
+
+static uint8_t *put_varint(uint8_t *p, uint64_t value)
+{
+        while (value >= 0x80)
+        {
+                *p++ = (uint8_t)(value | 0x80);
+                value >>= 7;
+        }
+        *p++ = (uint8_t)value;
+        return p;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+        uint32_t value = 0;
+        int k;
+        for (k = 0; k < 4; k++)
+        {
+                value |= (uint32_t)p[k] << (8 * k);
+        }
+        return value;
+}
+
+static uint64_t get_u64(const uint8_t *p)
+{
+        uint64_t value = 0;
+        int k;
+        for (k = 0; k < 8; k++)
+        {
+                value |= (uint64_t)p[k] << (8 * k);
+        }
+        return value;
+}
+
+static double get_f64(const uint8_t *p)
+{
+        uint64_t bits = get_u64(p);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+}
+
+/* returns NULL when the varint runs past p_end or past 64 bits */
+static const uint8_t *get_varint(const uint8_t *p, const uint8_t *p_end, uint64_t *p_value)
+{
+        uint64_t value = 0;
+        int shift;
+        for (shift = 0; shift < 64 && p < p_end; shift += 7)
+        {
+                uint8_t byte = *p++;
+                value |= (uint64_t)(byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0)
+                {
+                        *p_value = value;
+                        return p;
+                }
+        }
+        return NULL;
+}
+
+/* zigzag keeps small negative differences small */
+static inline uint64_t zigzag_encode(uint64_t delta)
+{
+        return (delta << 1) ^ (uint64_t)((int64_t)delta >> 63);
+}
+
+static inline uint64_t zigzag_decode(uint64_t value)
+{
+        return (value >> 1) ^ (0 - (value & 1));
+}
+
+size_t histogram_encoded_size_bound(const struct s_histogram_spec *p_spec)
+{
+        return HEADER_SIZE + (size_t)p_spec->nb_bins * MAX_VARINT_SIZE;
+}
+
+size_t histogram_encode(const struct s_histogram_spec *p_spec, const uint64_t *counts, uint8_t *buffer)
+{
+        const int nb_bins = p_spec->nb_bins;
+
+        uint64_t total = 0;
+        int j;
+        for (j = 0; j < nb_bins + 2; j++)
+        {
+                total += counts[j];
+        }
+
+        uint8_t *p = buffer;
+        memcpy(p, histogram_magic, sizeof(histogram_magic));
+        p += sizeof(histogram_magic);
+        *p++ = HISTOGRAM_FORMAT_VERSION;
+        *p++ = (uint8_t)p_spec->scale;
+        *p++ = (uint8_t)p_spec->precision;
+        *p++ = 0;
+        p = put_u32(p, (uint32_t)nb_bins);
+        p = put_f64(p, p_spec->lower_bound);
+        p = put_f64(p, p_spec->upper_bound);
+        p = put_u64(p, total);
+        p = put_u64(p, counts[nb_bins]);
+        p = put_u64(p, counts[nb_bins + 1]);
+
+        uint64_t previous = 0;
+        for (j = 0; j < nb_bins; j++)
+        {
+                p = put_varint(p, zigzag_encode(counts[j] - previous));
+                previous = counts[j];
+        }
+        return p - buffer;
+}
+
+int histogram_decode_spec(const uint8_t *buffer, size_t buffer_size, struct s_histogram_spec *p_spec)
+{
+        if (buffer_size < HEADER_SIZE || memcmp(buffer, histogram_magic, sizeof(histogram_magic)) != 0 ||
+            buffer[4] != HISTOGRAM_FORMAT_VERSION)
+        {
+                return -1;
+        }
+
+        struct s_histogram_spec spec;
+        memset(&spec, 0, sizeof(spec));
+        spec.scale = (enum e_histogram_scale)buffer[5];
+        spec.precision = buffer[6];
+        spec.nb_bins = (int)get_u32(buffer + 8);
+        spec.lower_bound = get_f64(buffer + 12);
+        spec.upper_bound = get_f64(buffer + 20);
+        if ((spec.scale != histogram_scale_linear && spec.scale != histogram_scale_loglinear) || spec.nb_bins < 1 ||
+            !histogram_spec_is_valid(&spec))
+        {
+                return -1;
+        }
+
+        *p_spec = spec;
+        return 0;
+}
+
+int histogram_decode_add(const uint8_t *buffer, size_t buffer_size, const struct s_histogram_spec *p_spec, uint64_t *counts)
+{
+        struct s_histogram_spec spec;
+        if (histogram_decode_spec(buffer, buffer_size, &spec) != 0 || !histogram_spec_equal(&spec, p_spec))
+        {
+                return -1;
+        }
+
+        const int nb_bins = spec.nb_bins;
+        const uint64_t total = get_u64(buffer + 28);
+        const uint64_t underflow = get_u64(buffer + 36);
+        const uint64_t overflow = get_u64(buffer + 44);
+
+        const uint8_t *p = buffer + HEADER_SIZE;
+        const uint8_t *p_end = buffer + buffer_size;
+        uint64_t sum = underflow + overflow;
+        uint64_t previous = 0;
+        int j;
+        for (j = 0; j < nb_bins; j++)
+        {
+                uint64_t value;
+                p = get_varint(p, p_end, &value);
+                if (p == NULL)
+                {
+                        return -1;
+                }
+                previous += zigzag_decode(value);
+                counts[j] += previous;
+                sum += previous;
+        }
+        counts[nb_bins] += underflow;
+        counts[nb_bins + 1] += overflow;
+
+        /* the counts were already added: a mismatch still reports the shard as corrupted */
+        return (p == p_end && sum == total) ? 0 : -1;
+}
+
+int histogram_write_file(const char *filename, const struct s_histogram_spec *p_spec, const uint64_t *counts)
+{
+        uint8_t *buffer = malloc(histogram_encoded_size_bound(p_spec));
+        if (buffer == NULL)
+        {
+                return -1;
+        }
+        size_t size = histogram_encode(p_spec, counts, buffer);
+
+        int ret = -1;
+        FILE *file = fopen(filename, "wb");
+        if (file != NULL)
+        {
+                ret = (fwrite(buffer, 1, size, file) == size) ? 0 : -1;
+                if (fclose(file) != 0)
+                {
+                        ret = -1;
+                }
+        }
+        free(buffer);
+        return ret;
+}
+
+int histogram_read_file(const char *filename, uint8_t **p_buffer, size_t *p_buffer_size)
+{
+        FILE *file = fopen(filename, "rb");
+        if (file == NULL)
+        {
+                return -1;
+        }
+
+        size_t capacity = 4096;
+        size_t size = 0;
+        uint8_t *buffer = malloc(capacity);
+        while (buffer != NULL)
+        {
+                size += fread(buffer + size, 1, capacity - size, file);
+                if (size < capacity)
+                {
+                        break;
+                }
+                capacity *= 2;
+                uint8_t *new_buffer = realloc(buffer, capacity);
+                if (new_buffer == NULL)
+                {
+                        free(buffer);
+                }
+                buffer = new_buffer;
+        }
+
+        int failed = (buffer == NULL) || ferror(file);
+        fclose(file);
+        if (failed)
+        {
+                free(buffer);
+                return -1;
+        }
+
+        *p_buffer = buffer;
+        *p_buffer_size = size;
+        return 0;
+}
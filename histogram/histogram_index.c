@@ -0,0 +1,237 @@
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "histogram.h"
+
+struct s_histogram_index
+{
+        struct s_histogram_spec spec;
+        struct s_histogram_binning binning;
+        int nb_bins;
+        int top_step;
+        uint64_t *counts;
+        uint64_t *tree;
+};
+
+int histogram_index_init(struct s_histogram_index **pp_index, const struct s_histogram_spec *p_spec)
+{
+        if (!histogram_spec_is_valid(p_spec))
+        {
+                return -1;
+        }
+
+        struct s_histogram_index *p_index = calloc(1, sizeof(*p_index));
+        if (p_index == NULL)
+        {
+                return -1;
+        }
+
+        p_index->spec = *p_spec;
+        p_index->binning = histogram_binning(p_spec);
+        p_index->nb_bins = p_spec->nb_bins;
+        p_index->top_step = 1;
+        while (p_index->top_step * 2 <= p_index->nb_bins)
+        {
+                p_index->top_step *= 2;
+        }
+
+        /* the tree is 1-based: tree[i] sums the (i & -i) bins ending at bin i - 1 */
+        p_index->counts = calloc(p_index->nb_bins, sizeof(*p_index->counts));
+        p_index->tree = calloc(p_index->nb_bins + 1, sizeof(*p_index->tree));
+        if (p_index->counts == NULL || p_index->tree == NULL)
+        {
+                free(p_index->counts);
+                free(p_index->tree);
+                free(p_index);
+                return -1;
+        }
+
+        *pp_index = p_index;
+        return 0;
+}
+
+void histogram_index_delete(struct s_histogram_index **pp_index)
+{
+        struct s_histogram_index *p_index = *pp_index;
+        if (p_index == NULL)
+        {
+                return;
+        }
+        free(p_index->counts);
+        free(p_index->tree);
+        free(p_index);
+        *pp_index = NULL;
+}
+
+/* O(nb_bins) construction from p_index->counts, instead of nb_bins O(log) updates */
+static void build_tree(struct s_histogram_index *p_index)
+{
+        const int nb_bins = p_index->nb_bins;
+        uint64_t *tree = p_index->tree;
+
+        tree[0] = 0;
+        memcpy(tree + 1, p_index->counts, nb_bins * sizeof(*tree));
+        int i;
+        for (i = 1; i <= nb_bins; i++)
+        {
+                int parent = i + (i & -i);
+                if (parent <= nb_bins)
+                {
+                        tree[parent] += tree[i];
+                }
+        }
+}
+
+void histogram_index_build(struct s_histogram_index *p_index, const uint64_t *counts)
+{
+        memcpy(p_index->counts, counts, p_index->nb_bins * sizeof(*counts));
+        build_tree(p_index);
+}
+
+void histogram_index_build_int(struct s_histogram_index *p_index, const int *counts)
+{
+        int j;
+        for (j = 0; j < p_index->nb_bins; j++)
+        {
+                p_index->counts[j] = (counts[j] > 0) ? (uint64_t)counts[j] : 0;
+        }
+        build_tree(p_index);
+}
+
+void histogram_index_update(struct s_histogram_index *p_index, int bin, int64_t delta)
+{
+        p_index->counts[bin] += delta;
+        int i;
+        for (i = bin + 1; i <= p_index->nb_bins; i += i & -i)
+        {
+                p_index->tree[i] += delta;
+        }
+}
+
+uint64_t histogram_index_prefix_count(const struct s_histogram_index *p_index, int nb_first_bins)
+{
+        if (nb_first_bins > p_index->nb_bins)
+        {
+                nb_first_bins = p_index->nb_bins;
+        }
+        uint64_t sum = 0;
+        int i;
+        for (i = nb_first_bins; i > 0; i -= i & -i)
+        {
+                sum += p_index->tree[i];
+        }
+        return sum;
+}
+
+uint64_t histogram_index_total(const struct s_histogram_index *p_index)
+{
+        return histogram_index_prefix_count(p_index, p_index->nb_bins);
+}
+
+uint64_t histogram_index_bin_range_count(const struct s_histogram_index *p_index, int first_bin, int last_bin)
+{
+        if (first_bin < 0)
+        {
+                first_bin = 0;
+        }
+        if (last_bin < first_bin)
+        {
+                return 0;
+        }
+        return histogram_index_prefix_count(p_index, last_bin + 1) - histogram_index_prefix_count(p_index, first_bin);
+}
+
+/* bin holding value; ranges overlapping the bounds only partly are clamped to the first or last bin */
+static int clamped_bin(const struct s_histogram_index *p_index, double value)
+{
+        int j = histogram_binning_slot(&p_index->binning, (ELEMENT_TYPE)value);
+        if (j == p_index->nb_bins)
+        {
+                return 0;
+        }
+        if (j == p_index->nb_bins + 1)
+        {
+                return p_index->nb_bins - 1;
+        }
+        return j;
+}
+
+uint64_t histogram_index_range_count(const struct s_histogram_index *p_index, double lower_value, double upper_value)
+{
+        if (isnan(lower_value) || isnan(upper_value) || upper_value < lower_value)
+        {
+                return 0;
+        }
+
+        /* linear bins span [lower_bound, upper_bound], loglinear ones every non-negative float */
+        const double lower_bound = histogram_bin_edge(&p_index->spec, 0);
+        const double upper_bound = (p_index->spec.scale == histogram_scale_linear) ? p_index->spec.upper_bound
+                                                                                  : histogram_bin_edge(&p_index->spec, p_index->nb_bins);
+        if (upper_value < lower_bound || lower_value >= upper_bound)
+        {
+                return 0;
+        }
+        return histogram_index_bin_range_count(p_index, clamped_bin(p_index, lower_value), clamped_bin(p_index, upper_value));
+}
+
+/* 1-based rank of the q-quantile sample, 0 for an empty index */
+static uint64_t quantile_rank(const struct s_histogram_index *p_index, double q)
+{
+        const uint64_t total = histogram_index_total(p_index);
+        if (total == 0)
+        {
+                return 0;
+        }
+        q = (q < 0.0) ? 0.0 : ((q > 1.0) ? 1.0 : q);
+        uint64_t rank = (uint64_t)ceil(q * (double)total);
+        return (rank < 1) ? 1 : ((rank > total) ? total : rank);
+}
+
+/* Fenwick descent: largest prefix of bins whose count is below rank, in O(log nb_bins) */
+static int find_rank(const struct s_histogram_index *p_index, uint64_t rank, uint64_t *p_count_before)
+{
+        int position = 0;
+        uint64_t remaining = rank;
+        int step;
+        for (step = p_index->top_step; step > 0; step >>= 1)
+        {
+                int next = position + step;
+                if (next <= p_index->nb_bins && p_index->tree[next] < remaining)
+                {
+                        position = next;
+                        remaining -= p_index->tree[next];
+                }
+        }
+        *p_count_before = rank - remaining;
+        return position;
+}
+
+int histogram_index_quantile_bin(const struct s_histogram_index *p_index, double q)
+{
+        uint64_t rank = quantile_rank(p_index, q);
+        if (rank == 0)
+        {
+                return -1;
+        }
+        uint64_t count_before;
+        return find_rank(p_index, rank, &count_before);
+}
+
+double histogram_index_quantile(const struct s_histogram_index *p_index, double q)
+{
+        uint64_t rank = quantile_rank(p_index, q);
+        if (rank == 0)
+        {
+                return NAN;
+        }
+        uint64_t count_before;
+        int j = find_rank(p_index, rank, &count_before);
+
+        /* the last loglinear bin ends at +inf, yet only holds finite floats */
+        const double lower_edge = histogram_bin_edge(&p_index->spec, j);
+        const double upper_edge = fmin(histogram_bin_edge(&p_index->spec, j + 1), FLT_MAX);
+        const double fraction = (double)(rank - count_before) / (double)p_index->counts[j];
+        return lower_edge + fraction * (upper_edge - lower_edge);
+}
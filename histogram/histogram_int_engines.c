@@ -0,0 +1,264 @@
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "histogram_engine.h"
+
+/* every integer up to 2^24 converts exactly to float */
+#define FLOAT_EXACT_INT_LIMIT (1 << 24)
+
+/*
+ * Integer samples are binned with the rule of the float engines applied to
+ * the value converted to ELEMENT_TYPE, so that they agree bin for bin.
+ */
+static inline int int_bin_index(const struct s_histogram_binning *p_binning, uint32_t value)
+{
+        return histogram_binning_index(p_binning, (ELEMENT_TYPE)value);
+}
+
+/*
+ * When bins start at 0 and are 2^shift wide, with every value up to the
+ * upper bound exact as a float, the float rule reduces to value >> shift,
+ * the upper bound itself going to the last bin. Returns -1 otherwise.
+ */
+static int power_of_two_shift(const struct s_histogram_spec *p_spec)
+{
+        if (p_spec->scale != histogram_scale_linear || p_spec->lower_bound != 0.0 || !(p_spec->upper_bound < FLOAT_EXACT_INT_LIMIT))
+        {
+                return -1;
+        }
+        int shift;
+        for (shift = 0; (1 << shift) < FLOAT_EXACT_INT_LIMIT; shift++)
+        {
+                if ((double)p_spec->nb_bins * (1 << shift) == p_spec->upper_bound)
+                {
+                        return shift;
+                }
+        }
+        return -1;
+}
+
+static inline int shift_bin_index(uint32_t value, int shift, uint32_t upper_value, int nb_bins)
+{
+        int j = (int)(value >> shift);
+        if (j < nb_bins)
+        {
+                return j;
+        }
+        return (value == upper_value) ? nb_bins - 1 : -1;
+}
+
+/* bin of every representable value of an 8- or 16-bit sample */
+static int *build_lookup_table(const struct s_histogram_spec *p_spec, int nb_values)
+{
+        const struct s_histogram_binning binning = histogram_binning(p_spec);
+        int *lookup_table = malloc(nb_values * sizeof(*lookup_table));
+        if (lookup_table == NULL)
+        {
+                PRINT_ERROR("memory allocation failed for lookup table");
+        }
+        int v;
+        for (v = 0; v < nb_values; v++)
+        {
+                lookup_table[v] = int_bin_index(&binning, v);
+        }
+        return lookup_table;
+}
+
+static int *allocate_partial_histograms(int nb_threads, int stride)
+{
+        int *partial_histograms = calloc((size_t)nb_threads * stride, sizeof(*partial_histograms));
+        if (partial_histograms == NULL)
+        {
+                PRINT_ERROR("memory allocation failed for partial histograms");
+        }
+        return partial_histograms;
+}
+
+static void reduce_partial_histograms(const int *partial_histograms, int nb_threads, int stride, int *histogram, int nb_bins)
+{
+        int j;
+#pragma omp parallel for schedule(static)
+        for (j = 0; j < nb_bins; j++)
+        {
+                int sum = 0;
+                int t;
+                for (t = 0; t < nb_threads; t++)
+                {
+                        sum += partial_histograms[(size_t)t * stride + j];
+                }
+                histogram[j] = sum;
+        }
+}
+
+void naive_compute_histogram_u8(const uint8_t *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec)
+{
+        const struct s_histogram_binning binning = histogram_binning(p_spec);
+        memset(histogram, 0, p_spec->nb_bins * sizeof(*histogram));
+
+        int i;
+        for (i = 0; i < array_len; i++)
+        {
+                int j = int_bin_index(&binning, array[i]);
+                if (j >= 0)
+                {
+                        histogram[j]++;
+                }
+        }
+}
+
+void naive_compute_histogram_u16(const uint16_t *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec)
+{
+        const struct s_histogram_binning binning = histogram_binning(p_spec);
+        memset(histogram, 0, p_spec->nb_bins * sizeof(*histogram));
+
+        int i;
+        for (i = 0; i < array_len; i++)
+        {
+                int j = int_bin_index(&binning, array[i]);
+                if (j >= 0)
+                {
+                        histogram[j]++;
+                }
+        }
+}
+
+void naive_compute_histogram_u32(const uint32_t *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec)
+{
+        const struct s_histogram_binning binning = histogram_binning(p_spec);
+        memset(histogram, 0, p_spec->nb_bins * sizeof(*histogram));
+
+        int i;
+        for (i = 0; i < array_len; i++)
+        {
+                int j = int_bin_index(&binning, array[i]);
+                if (j >= 0)
+                {
+                        histogram[j]++;
+                }
+        }
+}
+
+/* 256 entries: the lookup table always fits in L1 */
+void omp_compute_histogram_u8(const uint8_t *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec)
+{
+        const int nb_bins = p_spec->nb_bins;
+        const int nb_threads = omp_get_max_threads();
+        const int stride = histogram_padded_stride(nb_bins, sizeof(int));
+        int *lookup_table = build_lookup_table(p_spec, 1 << 8);
+        int *partial_histograms = allocate_partial_histograms(nb_threads, stride);
+
+#pragma omp parallel num_threads(nb_threads)
+        {
+                int *my_histogram = partial_histograms + (size_t)omp_get_thread_num() * stride;
+
+                int i;
+#pragma omp for schedule(static)
+                for (i = 0; i < array_len; i++)
+                {
+                        int j = lookup_table[array[i]];
+                        if (j >= 0)
+                        {
+                                my_histogram[j]++;
+                        }
+                }
+        }
+
+        reduce_partial_histograms(partial_histograms, nb_threads, stride, histogram, nb_bins);
+        free(partial_histograms);
+        free(lookup_table);
+}
+
+/* a shift when bins allow it, which leaves the cache to the partials, else a 256 KiB lookup table */
+void omp_compute_histogram_u16(const uint16_t *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec)
+{
+        const int nb_bins = p_spec->nb_bins;
+        const int nb_threads = omp_get_max_threads();
+        const int stride = histogram_padded_stride(nb_bins, sizeof(int));
+        const int shift = power_of_two_shift(p_spec);
+        const uint32_t upper_value = (uint32_t)p_spec->upper_bound;
+        int *lookup_table = (shift < 0) ? build_lookup_table(p_spec, 1 << 16) : NULL;
+        int *partial_histograms = allocate_partial_histograms(nb_threads, stride);
+
+#pragma omp parallel num_threads(nb_threads)
+        {
+                int *my_histogram = partial_histograms + (size_t)omp_get_thread_num() * stride;
+
+                int i;
+                if (shift >= 0)
+                {
+#pragma omp for schedule(static)
+                        for (i = 0; i < array_len; i++)
+                        {
+                                int j = shift_bin_index(array[i], shift, upper_value, nb_bins);
+                                if (j >= 0)
+                                {
+                                        my_histogram[j]++;
+                                }
+                        }
+                }
+                else
+                {
+#pragma omp for schedule(static)
+                        for (i = 0; i < array_len; i++)
+                        {
+                                int j = lookup_table[array[i]];
+                                if (j >= 0)
+                                {
+                                        my_histogram[j]++;
+                                }
+                        }
+                }
+        }
+
+        reduce_partial_histograms(partial_histograms, nb_threads, stride, histogram, nb_bins);
+        free(partial_histograms);
+        free(lookup_table);
+}
+
+/* too many values for a lookup table: a shift when bins allow it, else the float rule */
+void omp_compute_histogram_u32(const uint32_t *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec)
+{
+        const int nb_bins = p_spec->nb_bins;
+        const int nb_threads = omp_get_max_threads();
+        const int stride = histogram_padded_stride(nb_bins, sizeof(int));
+        const struct s_histogram_binning binning = histogram_binning(p_spec);
+        const int shift = power_of_two_shift(p_spec);
+        const uint32_t upper_value = (uint32_t)p_spec->upper_bound;
+        int *partial_histograms = allocate_partial_histograms(nb_threads, stride);
+
+#pragma omp parallel num_threads(nb_threads)
+        {
+                int *my_histogram = partial_histograms + (size_t)omp_get_thread_num() * stride;
+
+                int i;
+                if (shift >= 0)
+                {
+#pragma omp for schedule(static)
+                        for (i = 0; i < array_len; i++)
+                        {
+                                int j = shift_bin_index(array[i], shift, upper_value, nb_bins);
+                                if (j >= 0)
+                                {
+                                        my_histogram[j]++;
+                                }
+                        }
+                }
+                else
+                {
+#pragma omp for schedule(static)
+                        for (i = 0; i < array_len; i++)
+                        {
+                                int j = int_bin_index(&binning, array[i]);
+                                if (j >= 0)
+                                {
+                                        my_histogram[j]++;
+                                }
+                        }
+                }
+        }
+
+        reduce_partial_histograms(partial_histograms, nb_threads, stride, histogram, nb_bins);
+        free(partial_histograms);
+}
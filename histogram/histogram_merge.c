@@ -0,0 +1,250 @@
+#include <assert.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+
+#include "histogram.h"
+
+#define DEFAULT_OUTPUT_FILENAME "merged_histogram.hist"
+
+struct s_settings
+{
+        const char *output_filename;
+        const char **input_filenames;
+        int nb_inputs;
+        int nb_threads;
+        int enable_verbose;
+};
+
+static void usage(void)
+{
+        fprintf(stderr, "usage: histogram_merge [OPTIONS...] INPUT...\n");
+        fprintf(stderr, "    --output  OUTPUT_FILE\n");
+        fprintf(stderr, "    --threads  NB_THREADS\n");
+        fprintf(stderr, "    --verbose\n");
+        fprintf(stderr, "\n");
+        exit(EXIT_FAILURE);
+}
+
+static void init_settings(struct s_settings **pp_settings, int argc)
+{
+        assert(*pp_settings == NULL);
+        struct s_settings *p_settings = calloc(1, sizeof(*p_settings));
+        const char **input_filenames = calloc(argc, sizeof(*input_filenames));
+        if (p_settings == NULL || input_filenames == NULL)
+        {
+                PRINT_ERROR("memory allocation failed");
+        }
+        p_settings->output_filename = DEFAULT_OUTPUT_FILENAME;
+        p_settings->input_filenames = input_filenames;
+        p_settings->nb_inputs = 0;
+        p_settings->nb_threads = omp_get_max_threads();
+        p_settings->enable_verbose = 0;
+        *pp_settings = p_settings;
+}
+
+static void parse_cmd_line(int argc, char *argv[], struct s_settings *p_settings)
+{
+        int i = 1;
+        while (i < argc)
+        {
+                if (strcmp(argv[i], "--output") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        p_settings->output_filename = argv[i];
+                }
+                else if (strcmp(argv[i], "--threads") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        int value = atoi(argv[i]);
+                        if (value < 1)
+                        {
+                                fprintf(stderr, "invalid NB_THREADS argument\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        p_settings->nb_threads = value;
+                }
+                else if (strcmp(argv[i], "--verbose") == 0)
+                {
+                        p_settings->enable_verbose = 1;
+                }
+                else if (strncmp(argv[i], "--", 2) == 0)
+                {
+                        usage();
+                }
+                else
+                {
+                        p_settings->input_filenames[p_settings->nb_inputs++] = argv[i];
+                }
+
+                i++;
+        }
+
+        if (p_settings->nb_inputs == 0)
+        {
+                usage();
+        }
+        if (p_settings->nb_threads > p_settings->nb_inputs)
+        {
+                p_settings->nb_threads = p_settings->nb_inputs;
+        }
+}
+
+static void delete_settings(struct s_settings **pp_settings)
+{
+        assert(*pp_settings != NULL);
+        free((*pp_settings)->input_filenames);
+        free(*pp_settings);
+        *pp_settings = NULL;
+}
+
+static void read_spec(const char *filename, struct s_histogram_spec *p_spec)
+{
+        uint8_t *buffer = NULL;
+        size_t buffer_size = 0;
+        if (histogram_read_file(filename, &buffer, &buffer_size) != 0)
+        {
+                perror(filename);
+                exit(EXIT_FAILURE);
+        }
+        if (histogram_decode_spec(buffer, buffer_size, p_spec) != 0)
+        {
+                fprintf(stderr, "%s: not a histogram file\n", filename);
+                exit(EXIT_FAILURE);
+        }
+        free(buffer);
+}
+
+/*
+ * Each thread decodes its share of the shards straight into its own counts,
+ * then the per-thread counts are reduced bin by bin, in parallel as well.
+ */
+static int merge(const struct s_histogram_spec *p_spec, uint64_t *counts, struct s_settings *p_settings)
+{
+        const int nb_slots = p_spec->nb_bins + 2;
+        const int nb_threads = p_settings->nb_threads;
+        uint64_t *partial_counts = calloc((size_t)nb_threads * nb_slots, sizeof(*partial_counts));
+        if (partial_counts == NULL)
+        {
+                PRINT_ERROR("memory allocation failed");
+        }
+
+        int nb_errors = 0;
+#pragma omp parallel num_threads(nb_threads) reduction(+ : nb_errors)
+        {
+                uint64_t *my_counts = partial_counts + (size_t)omp_get_thread_num() * nb_slots;
+
+                int i;
+#pragma omp for schedule(dynamic, 1)
+                for (i = 0; i < p_settings->nb_inputs; i++)
+                {
+                        const char *filename = p_settings->input_filenames[i];
+                        uint8_t *buffer = NULL;
+                        size_t buffer_size = 0;
+                        if (histogram_read_file(filename, &buffer, &buffer_size) != 0)
+                        {
+                                perror(filename);
+                                nb_errors++;
+                                continue;
+                        }
+                        if (histogram_decode_add(buffer, buffer_size, p_spec, my_counts) != 0)
+                        {
+                                fprintf(stderr, "%s: corrupted histogram or different bins\n", filename);
+                                nb_errors++;
+                        }
+                        free(buffer);
+                }
+        }
+
+        int j;
+#pragma omp parallel for num_threads(nb_threads) schedule(static)
+        for (j = 0; j < nb_slots; j++)
+        {
+                uint64_t sum = 0;
+                int t;
+                for (t = 0; t < nb_threads; t++)
+                {
+                        sum += partial_counts[(size_t)t * nb_slots + j];
+                }
+                counts[j] = sum;
+        }
+
+        free(partial_counts);
+        return nb_errors;
+}
+
+int main(int argc, char *argv[])
+{
+        struct s_settings *p_settings = NULL;
+
+        init_settings(&p_settings, argc);
+        parse_cmd_line(argc, argv, p_settings);
+
+        struct s_histogram_spec spec;
+        read_spec(p_settings->input_filenames[0], &spec);
+
+        uint64_t *counts = calloc(spec.nb_bins + 2, sizeof(*counts));
+        if (counts == NULL)
+        {
+                PRINT_ERROR("memory allocation failed");
+        }
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int nb_errors = merge(&spec, counts, p_settings);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double merge_time = bench_elapsed(&start, &end);
+
+        if (nb_errors > 0)
+        {
+                fprintf(stderr, "%d input(s) could not be merged\n", nb_errors);
+                exit(EXIT_FAILURE);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (histogram_write_file(p_settings->output_filename, &spec, counts) != 0)
+        {
+                perror(p_settings->output_filename);
+                exit(EXIT_FAILURE);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double write_time = bench_elapsed(&start, &end);
+
+        uint64_t total = 0;
+        int j;
+        for (j = 0; j < spec.nb_bins + 2; j++)
+        {
+                total += counts[j];
+        }
+
+        printf("nb_inputs,nb_bins,nb_threads,total,underflow,overflow,merge_time,write_time\n");
+        printf("%d,%d,%d,%llu,%llu,%llu,%le,%le\n", p_settings->nb_inputs, spec.nb_bins, p_settings->nb_threads,
+               (unsigned long long)total, (unsigned long long)counts[spec.nb_bins],
+               (unsigned long long)counts[spec.nb_bins + 1], merge_time, write_time);
+
+        if (p_settings->enable_verbose)
+        {
+                for (j = 0; j < spec.nb_bins; j++)
+                {
+                        printf(" [ %8.2lg ... %8.2lg [ :  %llu\n", histogram_bin_edge(&spec, j), histogram_bin_edge(&spec, j + 1),
+                               (unsigned long long)counts[j]);
+                }
+        }
+
+        free(counts);
+        delete_settings(&p_settings);
+
+        return 0;
+}
@@ -0,0 +1,790 @@
+#include <assert.h>
+#include <mpi.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+#include "perf_counters.h"
+#include "phase_timer.h"
+
+#include "histogram.h"
+
+#define DEFAULT_SHARD_LEN 1000000
+#define DEFAULT_CHUNK_LEN (1 << 20)
+#define DEFAULT_NB_BINS 5
+#define DEFAULT_LOWER_BOUND 0.0
+#define DEFAULT_UPPER_BOUND 10.0
+#define DEFAULT_NB_REPEAT 10
+#define DEFAULT_NB_WARMUP 0
+#define DEFAULT_MIN_TIME 0.0
+#define DEFAULT_NB_CHECK_SHARDS 2
+#define DEFAULT_SEED 1
+
+/* above this many bins no single rank gathers the whole histogram */
+#define REDUCE_SCATTER_MIN_BINS (1 << 20)
+
+#define ROOT_RANK 0
+#define TAG_SHARD_COUNTS 1
+
+enum e_reduction
+{
+        reduction_auto = 0,
+        reduction_reduce,
+        reduction_reduce_scatter
+};
+
+static const char *reduction_names[] = {"auto", "reduce", "reduce-scatter"};
+
+struct s_settings
+{
+        long long shard_len;
+        int chunk_len;
+        int nb_bins;
+        double lower_bound;
+        double upper_bound;
+        struct s_histogram_spec spec;
+        enum e_reduction reduction;
+        int nb_repeat;
+        int nb_warmup;
+        double min_time;
+        int nb_check_shards;
+        unsigned int seed;
+        int enable_pinning;
+        int enable_summary;
+        int enable_perf_counters;
+        int enable_phase_timing;
+        int enable_verbose;
+};
+
+#define MPI_CHECK(OP, RET)                                                    \
+        do                                                                    \
+        {                                                                     \
+                if ((RET) != MPI_SUCCESS)                                     \
+                {                                                             \
+                        fprintf(stderr, "%s:%d - %s failed\n", __FILE__, __LINE__, (OP)); \
+                        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);              \
+                }                                                             \
+        } while (0)
+
+static void usage(void)
+{
+        fprintf(stderr, "usage: mpirun -n NB_RANKS histogram_mpi [OPTIONS...]\n");
+        fprintf(stderr, "    --shard-len  SHARD_LENGTH\n");
+        fprintf(stderr, "    --chunk-len  CHUNK_LENGTH\n");
+        fprintf(stderr, "    --nb-bins  NB_BINS\n");
+        fprintf(stderr, "    --lower-bound  LOWER_BOUND\n");
+        fprintf(stderr, "    --upper-bound  UPPER_BOUND\n");
+        fprintf(stderr, "    --reduction  <auto|reduce|reduce-scatter>\n");
+        fprintf(stderr, "    --nb-repeat NB_REPEAT\n");
+        fprintf(stderr, "    --warmup NB_WARMUP\n");
+        fprintf(stderr, "    --min-time MIN_TIME\n");
+        fprintf(stderr, "    --check-shards NB_CHECK_SHARDS\n");
+        fprintf(stderr, "    --seed SEED\n");
+        fprintf(stderr, "    --no-pin\n");
+        fprintf(stderr, "    --summary\n");
+        fprintf(stderr, "    --perf-counters\n");
+        fprintf(stderr, "    --phase-timing\n");
+        fprintf(stderr, "    --verbose\n");
+        fprintf(stderr, "\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        exit(EXIT_FAILURE);
+}
+
+static void init_settings(struct s_settings **pp_settings)
+{
+        assert(*pp_settings == NULL);
+        struct s_settings *p_settings = calloc(1, sizeof(*p_settings));
+        if (p_settings == NULL)
+        {
+                PRINT_ERROR("memory allocation failed");
+        }
+        p_settings->shard_len = DEFAULT_SHARD_LEN;
+        p_settings->chunk_len = DEFAULT_CHUNK_LEN;
+        p_settings->nb_bins = DEFAULT_NB_BINS;
+        p_settings->lower_bound = DEFAULT_LOWER_BOUND;
+        p_settings->upper_bound = DEFAULT_UPPER_BOUND;
+        p_settings->reduction = reduction_auto;
+        p_settings->nb_repeat = DEFAULT_NB_REPEAT;
+        p_settings->nb_warmup = DEFAULT_NB_WARMUP;
+        p_settings->min_time = DEFAULT_MIN_TIME;
+        p_settings->nb_check_shards = DEFAULT_NB_CHECK_SHARDS;
+        p_settings->seed = DEFAULT_SEED;
+        p_settings->enable_pinning = 1;
+        p_settings->enable_summary = 0;
+        p_settings->enable_perf_counters = 0;
+        p_settings->enable_phase_timing = 0;
+        p_settings->enable_verbose = 0;
+        *pp_settings = p_settings;
+}
+
+static void parse_cmd_line(int argc, char *argv[], struct s_settings *p_settings)
+{
+        int i = 1;
+        while (i < argc)
+        {
+                if (strcmp(argv[i], "--shard-len") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        long long value = atoll(argv[i]);
+                        if (value < 1)
+                        {
+                                fprintf(stderr, "invalid SHARD_LENGTH argument\n");
+                                usage();
+                        }
+                        p_settings->shard_len = value;
+                }
+                else if (strcmp(argv[i], "--chunk-len") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        int value = atoi(argv[i]);
+                        if (value < 1)
+                        {
+                                fprintf(stderr, "invalid CHUNK_LENGTH argument\n");
+                                usage();
+                        }
+                        p_settings->chunk_len = value;
+                }
+                else if (strcmp(argv[i], "--nb-bins") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        int value = atoi(argv[i]);
+                        if (value < 1)
+                        {
+                                fprintf(stderr, "invalid NB_BINS argument\n");
+                                usage();
+                        }
+                        p_settings->nb_bins = value;
+                }
+                else if (strcmp(argv[i], "--lower-bound") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        p_settings->lower_bound = atof(argv[i]);
+                }
+                else if (strcmp(argv[i], "--upper-bound") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        p_settings->upper_bound = atof(argv[i]);
+                }
+                else if (strcmp(argv[i], "--reduction") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        if (strcmp(argv[i], "auto") == 0)
+                        {
+                                p_settings->reduction = reduction_auto;
+                        }
+                        else if (strcmp(argv[i], "reduce") == 0)
+                        {
+                                p_settings->reduction = reduction_reduce;
+                        }
+                        else if (strcmp(argv[i], "reduce-scatter") == 0)
+                        {
+                                p_settings->reduction = reduction_reduce_scatter;
+                        }
+                        else
+                        {
+                                usage();
+                        }
+                }
+                else if (strcmp(argv[i], "--nb-repeat") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        int value = atoi(argv[i]);
+                        if (value < 1)
+                        {
+                                fprintf(stderr, "invalid NB_REPEAT argument\n");
+                                usage();
+                        }
+                        p_settings->nb_repeat = value;
+                }
+                else if (strcmp(argv[i], "--warmup") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        int value = atoi(argv[i]);
+                        if (value < 0)
+                        {
+                                fprintf(stderr, "invalid NB_WARMUP argument\n");
+                                usage();
+                        }
+                        p_settings->nb_warmup = value;
+                }
+                else if (strcmp(argv[i], "--min-time") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        double value = atof(argv[i]);
+                        if (!(value >= 0.0))
+                        {
+                                fprintf(stderr, "invalid MIN_TIME argument\n");
+                                usage();
+                        }
+                        p_settings->min_time = value;
+                }
+                else if (strcmp(argv[i], "--check-shards") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        int value = atoi(argv[i]);
+                        if (value < 0)
+                        {
+                                fprintf(stderr, "invalid NB_CHECK_SHARDS argument\n");
+                                usage();
+                        }
+                        p_settings->nb_check_shards = value;
+                }
+                else if (strcmp(argv[i], "--seed") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        p_settings->seed = (unsigned int)atoi(argv[i]);
+                }
+                else if (strcmp(argv[i], "--no-pin") == 0)
+                {
+                        p_settings->enable_pinning = 0;
+                }
+                else if (strcmp(argv[i], "--summary") == 0)
+                {
+                        p_settings->enable_summary = 1;
+                }
+                else if (strcmp(argv[i], "--perf-counters") == 0)
+                {
+                        p_settings->enable_perf_counters = 1;
+                }
+                else if (strcmp(argv[i], "--phase-timing") == 0)
+                {
+                        p_settings->enable_phase_timing = 1;
+                }
+                else if (strcmp(argv[i], "--verbose") == 0)
+                {
+                        p_settings->enable_verbose = 1;
+                }
+                else
+                {
+                        usage();
+                }
+
+                i++;
+        }
+
+        if (!(p_settings->upper_bound > p_settings->lower_bound))
+        {
+                fprintf(stderr, "invalid histogram bounds\n");
+                usage();
+        }
+
+        p_settings->spec.nb_bins = p_settings->nb_bins;
+        p_settings->spec.lower_bound = p_settings->lower_bound;
+        p_settings->spec.upper_bound = p_settings->upper_bound;
+        p_settings->spec.scale = histogram_scale_linear;
+
+        if (p_settings->reduction == reduction_auto)
+        {
+                p_settings->reduction = (p_settings->nb_bins >= REDUCE_SCATTER_MIN_BINS) ? reduction_reduce_scatter : reduction_reduce;
+        }
+}
+
+static void delete_settings(struct s_settings **pp_settings)
+{
+        assert(*pp_settings != NULL);
+        free(*pp_settings);
+        *pp_settings = NULL;
+}
+
+/*
+ * Shard data is a pure function of (seed, rank, chunk): the root can rebuild
+ * any rank's shard to check it without the data ever being sent.
+ */
+static void generate_chunk(ELEMENT_TYPE *chunk, int chunk_len, unsigned int *p_state, struct s_settings *p_settings)
+{
+        const ELEMENT_TYPE offset = p_settings->lower_bound;
+        const ELEMENT_TYPE scale = p_settings->upper_bound - p_settings->lower_bound;
+
+        int i;
+        for (i = 0; i < chunk_len; i++)
+        {
+                chunk[i] = scale * ((ELEMENT_TYPE)rand_r(p_state)) / (1.0 + (ELEMENT_TYPE)(RAND_MAX)) + offset;
+        }
+}
+
+static unsigned int shard_seed(int rank, struct s_settings *p_settings)
+{
+        return p_settings->seed * 2654435761u + (unsigned int)rank;
+}
+
+/* counts this rank's shard chunk by chunk, so that shards need not fit in memory; generating a chunk is its init phase */
+static void count_shard(struct s_histogram_context *p_context, ELEMENT_TYPE *chunk, int rank, struct s_phase_timer *p_timer,
+                        struct s_settings *p_settings)
+{
+        unsigned int state = shard_seed(rank, p_settings);
+        histogram_context_reset(p_context);
+
+        long long offset;
+        for (offset = 0; offset < p_settings->shard_len; offset += p_settings->chunk_len)
+        {
+                long long remaining = p_settings->shard_len - offset;
+                int chunk_len = (remaining < p_settings->chunk_len) ? (int)remaining : p_settings->chunk_len;
+                phase_timer_begin(p_timer, phase_init);
+                generate_chunk(chunk, chunk_len, &state, p_settings);
+                phase_timer_end(p_timer, phase_init);
+
+                phase_timer_begin(p_timer, phase_kernel);
+                histogram_context_add(p_context, chunk, chunk_len);
+                phase_timer_end(p_timer, phase_kernel);
+        }
+}
+
+/* reference count of a rank's shard, rebuilt on the root with the naive engine */
+static void check_count_shard(uint64_t *check_counts, int *chunk_histogram, ELEMENT_TYPE *chunk, int rank, struct s_settings *p_settings)
+{
+        const int nb_bins = p_settings->nb_bins;
+        unsigned int state = shard_seed(rank, p_settings);
+        memset(check_counts, 0, nb_bins * sizeof(*check_counts));
+
+        long long offset;
+        for (offset = 0; offset < p_settings->shard_len; offset += p_settings->chunk_len)
+        {
+                long long remaining = p_settings->shard_len - offset;
+                int chunk_len = (remaining < p_settings->chunk_len) ? (int)remaining : p_settings->chunk_len;
+                generate_chunk(chunk, chunk_len, &state, p_settings);
+                naive_compute_histogram(chunk, chunk_len, chunk_histogram, &p_settings->spec);
+                int j;
+                for (j = 0; j < nb_bins; j++)
+                {
+                        check_counts[j] += chunk_histogram[j];
+                }
+        }
+}
+
+/* evenly spread sample ranks, always including the root and the last rank */
+static int is_check_shard(int rank, int nb_ranks, struct s_settings *p_settings)
+{
+        const int nb_check_shards = (p_settings->nb_check_shards < nb_ranks) ? p_settings->nb_check_shards : nb_ranks;
+        int k;
+        for (k = 0; k < nb_check_shards; k++)
+        {
+                int sample_rank = (nb_check_shards == 1) ? 0 : (int)((long long)k * (nb_ranks - 1) / (nb_check_shards - 1));
+                if (sample_rank == rank)
+                {
+                        return 1;
+                }
+        }
+        return 0;
+}
+
+/* split nb_slots into nb_ranks contiguous slices for reduce-scatter */
+static void init_slices(int *slice_lens, int nb_slots, int nb_ranks)
+{
+        int r;
+        for (r = 0; r < nb_ranks; r++)
+        {
+                slice_lens[r] = nb_slots / nb_ranks + ((r < nb_slots % nb_ranks) ? 1 : 0);
+        }
+}
+
+static int check(const uint64_t *shard_counts, uint64_t global_total, int rank, int nb_ranks, struct s_settings *p_settings)
+{
+        const int nb_bins = p_settings->nb_bins;
+        const int nb_slots = nb_bins + 2;
+        int check_status = 0;
+
+        /* every sample shard must match its naive recount bin for bin */
+        uint64_t *received_counts = NULL;
+        uint64_t *check_counts = NULL;
+        int *chunk_histogram = NULL;
+        ELEMENT_TYPE *chunk = NULL;
+        if (rank == ROOT_RANK)
+        {
+                received_counts = malloc(nb_slots * sizeof(*received_counts));
+                check_counts = malloc(nb_bins * sizeof(*check_counts));
+                chunk_histogram = malloc(nb_bins * sizeof(*chunk_histogram));
+                chunk = malloc(p_settings->chunk_len * sizeof(*chunk));
+                if (received_counts == NULL || check_counts == NULL || chunk_histogram == NULL || chunk == NULL)
+                {
+                        PRINT_ERROR("memory allocation failed");
+                }
+        }
+
+        int r;
+        for (r = 0; r < nb_ranks; r++)
+        {
+                if (!is_check_shard(r, nb_ranks, p_settings))
+                {
+                        continue;
+                }
+                if (rank == r && rank != ROOT_RANK)
+                {
+                        MPI_CHECK("MPI_Send", MPI_Send(shard_counts, nb_slots, MPI_UINT64_T, ROOT_RANK, TAG_SHARD_COUNTS, MPI_COMM_WORLD));
+                }
+                if (rank == ROOT_RANK)
+                {
+                        const uint64_t *counts = shard_counts;
+                        if (r != ROOT_RANK)
+                        {
+                                MPI_CHECK("MPI_Recv", MPI_Recv(received_counts, nb_slots, MPI_UINT64_T, r, TAG_SHARD_COUNTS, MPI_COMM_WORLD,
+                                                               MPI_STATUS_IGNORE));
+                                counts = received_counts;
+                        }
+                        check_count_shard(check_counts, chunk_histogram, chunk, r, p_settings);
+                        int j;
+                        for (j = 0; j < nb_bins; j++)
+                        {
+                                if (counts[j] != check_counts[j])
+                                {
+                                        fprintf(stderr, "check failed [rank: %d, bin: %d]: run = %llu, check = %llu\n", r, j,
+                                                (unsigned long long)counts[j], (unsigned long long)check_counts[j]);
+                                        check_status = 1;
+                                        break;
+                                }
+                        }
+                }
+        }
+
+        if (rank == ROOT_RANK)
+        {
+                /* no sample is lost or counted twice by the reduction */
+                const uint64_t expected_total = (uint64_t)p_settings->shard_len * nb_ranks;
+                if (global_total != expected_total)
+                {
+                        fprintf(stderr, "check failed: global total = %llu, expected %llu\n", (unsigned long long)global_total,
+                                (unsigned long long)expected_total);
+                        check_status = 1;
+                }
+        }
+
+        free(received_counts);
+        free(check_counts);
+        free(chunk_histogram);
+        free(chunk);
+
+        MPI_CHECK("MPI_Bcast", MPI_Bcast(&check_status, 1, MPI_INT, ROOT_RANK, MPI_COMM_WORLD));
+        return check_status;
+}
+
+static void print_settings_csv_header(void)
+{
+        printf("engine,nb_ranks,nb_threads,shard_len,nb_bins,reduction,nb_repeat");
+}
+
+static void print_settings_csv(int nb_ranks, struct s_settings *p_settings)
+{
+        printf("mpi,%d,%d,%lld,%d,%s,%d", nb_ranks, omp_get_max_threads(), p_settings->shard_len, p_settings->nb_bins,
+               reduction_names[p_settings->reduction], p_settings->nb_repeat);
+}
+
+static void print_optional_csv_header(struct s_settings *p_settings)
+{
+        if (p_settings->enable_phase_timing)
+        {
+                printf(",");
+                phase_timer_print_csv_header();
+        }
+        if (p_settings->enable_perf_counters)
+        {
+                printf(",");
+                perf_counters_print_csv_header();
+        }
+        printf("\n");
+}
+
+static void print_csv_header(struct s_settings *p_settings)
+{
+        print_settings_csv_header();
+        printf(",rep,count_time,reduce_time,timing,check_status");
+        print_optional_csv_header(p_settings);
+}
+
+static void print_summary_csv_header(struct s_settings *p_settings)
+{
+        print_settings_csv_header();
+        printf(",");
+        bench_print_stats_csv_header();
+        printf(",elements_per_s,gb_per_s,check_status");
+        print_optional_csv_header(p_settings);
+}
+
+/*
+ * The slowest rank sets the pace: phase times are the largest over the
+ * ranks, on every rank so that they all agree on --min-time, and hardware
+ * counts are summed over the ranks on the root.
+ */
+static void reduce_phase_timer(struct s_phase_timer *p_timer, int rank)
+{
+        MPI_CHECK("MPI_Allreduce", MPI_Allreduce(MPI_IN_PLACE, p_timer->elapsed, NB_PHASES, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD));
+
+        phase_timer_collect(p_timer);
+
+        struct s_perf_counters *p_perf_counters = p_timer->p_perf_counters;
+        if (p_perf_counters != NULL)
+        {
+                double sums[NB_PERF_COUNTERS];
+                MPI_CHECK("MPI_Reduce", MPI_Reduce(p_perf_counters->last, sums, NB_PERF_COUNTERS, MPI_DOUBLE, MPI_SUM, ROOT_RANK, MPI_COMM_WORLD));
+                if (rank == ROOT_RANK)
+                {
+                        int c;
+                        for (c = 0; c < NB_PERF_COUNTERS; c++)
+                        {
+                                p_perf_counters->total[c] += sums[c] - p_perf_counters->last[c];
+                                p_perf_counters->last[c] = sums[c];
+                        }
+                }
+        }
+}
+
+int main(int argc, char *argv[])
+{
+        int provided;
+        MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+
+        int rank, nb_ranks;
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        MPI_Comm_size(MPI_COMM_WORLD, &nb_ranks);
+
+        struct s_settings *p_settings = NULL;
+        init_settings(&p_settings);
+        parse_cmd_line(argc, argv, p_settings);
+
+        /* within the CPUs the launcher bound this rank to */
+        if (p_settings->enable_pinning)
+        {
+                bench_pin_threads();
+        }
+
+        struct s_perf_counters perf_counters;
+        if (p_settings->enable_perf_counters)
+        {
+                perf_counters_init(&perf_counters);
+        }
+        struct s_phase_timer phase_timer;
+        phase_timer_init(&phase_timer, p_settings->enable_phase_timing, p_settings->enable_perf_counters ? &perf_counters : NULL);
+
+        const int nb_slots = p_settings->nb_bins + 2;
+
+        phase_timer_begin(&phase_timer, phase_alloc);
+        struct s_histogram_context *p_context = NULL;
+        if (histogram_context_init(&p_context, &p_settings->spec, 0) != 0)
+        {
+                PRINT_ERROR("histogram context initialization failed");
+        }
+
+        ELEMENT_TYPE *chunk = malloc(p_settings->chunk_len * sizeof(*chunk));
+        int *slice_lens = malloc(nb_ranks * sizeof(*slice_lens));
+        uint64_t *global_counts = NULL;
+        if (p_settings->reduction == reduction_reduce)
+        {
+                global_counts = (rank == ROOT_RANK) ? malloc(nb_slots * sizeof(*global_counts)) : NULL;
+        }
+        else
+        {
+                init_slices(slice_lens, nb_slots, nb_ranks);
+                /* with more ranks than slots, a slice can be empty, and malloc(0) may return NULL */
+                global_counts = malloc((slice_lens[rank] > 0 ? slice_lens[rank] : 1) * sizeof(*global_counts));
+        }
+        if (chunk == NULL || slice_lens == NULL || (global_counts == NULL && (rank == ROOT_RANK || p_settings->reduction != reduction_reduce)))
+        {
+                PRINT_ERROR("memory allocation failed");
+        }
+        phase_timer_end(&phase_timer, phase_alloc);
+
+        struct s_bench_samples samples;
+        bench_samples_init(&samples);
+        int summary_check_status = 0;
+
+        if (rank == ROOT_RANK)
+        {
+                if (p_settings->enable_summary)
+                {
+                        print_summary_csv_header(p_settings);
+                }
+                else
+                {
+                        print_csv_header(p_settings);
+                }
+        }
+
+        double measured_time = 0.0;
+        int iter;
+        for (iter = 0; iter < p_settings->nb_warmup + p_settings->nb_repeat || measured_time < p_settings->min_time; iter++)
+        {
+                const int is_warmup = iter < p_settings->nb_warmup;
+                const int rep = iter - p_settings->nb_warmup;
+                struct timespec start, counted, end;
+
+                phase_timer_reset(&phase_timer);
+
+                MPI_CHECK("MPI_Barrier", MPI_Barrier(MPI_COMM_WORLD));
+                clock_gettime(CLOCK_MONOTONIC, &start);
+
+                count_shard(p_context, chunk, rank, &phase_timer, p_settings);
+                clock_gettime(CLOCK_MONOTONIC, &counted);
+
+                phase_timer_begin(&phase_timer, phase_kernel);
+                const uint64_t *shard_counts = histogram_context_counts(p_context);
+                uint64_t local_total = 0;
+                if (p_settings->reduction == reduction_reduce)
+                {
+                        MPI_CHECK("MPI_Reduce", MPI_Reduce(shard_counts, global_counts, nb_slots, MPI_UINT64_T, MPI_SUM, ROOT_RANK, MPI_COMM_WORLD));
+                        if (rank == ROOT_RANK)
+                        {
+                                int j;
+                                for (j = 0; j < nb_slots; j++)
+                                {
+                                        local_total += global_counts[j];
+                                }
+                        }
+                }
+                else
+                {
+                        /* each rank ends up owning the global counts of one slice of the bins */
+                        MPI_CHECK("MPI_Reduce_scatter", MPI_Reduce_scatter(shard_counts, global_counts, slice_lens, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD));
+                        int j;
+                        for (j = 0; j < slice_lens[rank]; j++)
+                        {
+                                local_total += global_counts[j];
+                        }
+                }
+                MPI_CHECK("MPI_Barrier", MPI_Barrier(MPI_COMM_WORLD));
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                phase_timer_end(&phase_timer, phase_kernel);
+
+                uint64_t global_total = local_total;
+                if (p_settings->reduction == reduction_reduce_scatter)
+                {
+                        MPI_CHECK("MPI_Reduce", MPI_Reduce(&local_total, &global_total, 1, MPI_UINT64_T, MPI_SUM, ROOT_RANK, MPI_COMM_WORLD));
+                }
+
+                /* the slowest rank sets the pace, in every column and on every rank */
+                double max_times[3] = {bench_elapsed(&start, &counted), bench_elapsed(&counted, &end), bench_elapsed(&start, &end)};
+                MPI_CHECK("MPI_Allreduce", MPI_Allreduce(MPI_IN_PLACE, max_times, 3, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD));
+                const double timing_in_seconds = max_times[2];
+
+                if (is_warmup)
+                {
+                        continue;
+                }
+
+                measured_time += timing_in_seconds;
+
+                phase_timer_begin(&phase_timer, phase_check);
+                int check_status = check(shard_counts, global_total, rank, nb_ranks, p_settings);
+                phase_timer_end(&phase_timer, phase_check);
+
+                reduce_phase_timer(&phase_timer, rank);
+
+                if (rank != ROOT_RANK)
+                {
+                        continue;
+                }
+
+                if (p_settings->enable_verbose && p_settings->reduction == reduction_reduce)
+                {
+                        int j;
+                        for (j = 0; j < p_settings->nb_bins; j++)
+                        {
+                                printf(" [ %8.2lg ... %8.2lg [ :  %llu\n", histogram_bin_edge(&p_settings->spec, j),
+                                       histogram_bin_edge(&p_settings->spec, j + 1), (unsigned long long)global_counts[j]);
+                        }
+                }
+
+                if (p_settings->enable_summary)
+                {
+                        bench_samples_add(&samples, timing_in_seconds);
+                        summary_check_status |= check_status;
+                        continue;
+                }
+                print_settings_csv(nb_ranks, p_settings);
+                printf(",%d,%le,%le,%le,%d", rep, max_times[0], max_times[1], timing_in_seconds, check_status);
+                if (p_settings->enable_phase_timing)
+                {
+                        printf(",");
+                        phase_timer_print_csv(&phase_timer);
+                }
+                if (p_settings->enable_perf_counters)
+                {
+                        printf(",");
+                        perf_counters_print_last_csv(&perf_counters);
+                }
+                printf("\n");
+        }
+
+        if (rank == ROOT_RANK && p_settings->enable_summary)
+        {
+                struct s_bench_stats stats;
+                bench_compute_stats(&samples, &stats);
+                const double nb_elements = (double)p_settings->shard_len * nb_ranks;
+
+                print_settings_csv(nb_ranks, p_settings);
+                printf(",");
+                bench_print_stats_csv(&stats);
+                printf(",");
+                bench_print_throughput_csv(nb_elements, nb_elements * sizeof(ELEMENT_TYPE), &stats);
+                printf(",%d", summary_check_status);
+                if (p_settings->enable_phase_timing)
+                {
+                        printf(",");
+                        phase_timer_print_mean_csv(&phase_timer);
+                }
+                if (p_settings->enable_perf_counters)
+                {
+                        printf(",");
+                        perf_counters_print_mean_csv(&perf_counters);
+                }
+                printf("\n");
+        }
+
+        if (p_settings->enable_perf_counters)
+        {
+                perf_counters_delete(&perf_counters);
+        }
+        bench_samples_delete(&samples);
+        free(global_counts);
+        free(slice_lens);
+        free(chunk);
+        histogram_context_delete(&p_context);
+        delete_settings(&p_settings);
+
+        MPI_Finalize();
+        return 0;
+}
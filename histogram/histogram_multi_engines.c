@@ -0,0 +1,99 @@
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "histogram_engine.h"
+
+/* elements per block: small enough to stay in L1 while every spec walks it */
+#define BLOCK_LEN 2048
+
+/*
+ * The array is walked once, block by block; each block is binned for every
+ * spec in turn while it is still in cache, so memory traffic is that of one
+ * pass whatever the number of specs. Each spec keeps its own inner loop, with
+ * its binning loop-invariant, and per-thread partials like the omp engine.
+ */
+void omp_compute_multi_histogram(const ELEMENT_TYPE *array, int array_len, int *const *histograms, const struct s_histogram_spec *specs,
+                                 int nb_specs)
+{
+        struct s_histogram_binning *binnings = malloc(nb_specs * sizeof(*binnings));
+        int *offsets = malloc((nb_specs + 1) * sizeof(*offsets));
+        if (binnings == NULL || offsets == NULL)
+        {
+                PRINT_ERROR("memory allocation failed");
+        }
+
+        int k;
+        offsets[0] = 0;
+        for (k = 0; k < nb_specs; k++)
+        {
+                binnings[k] = histogram_binning(&specs[k]);
+                offsets[k + 1] = offsets[k] + specs[k].nb_bins;
+        }
+        const int nb_bins_total = offsets[nb_specs];
+        const int stride = histogram_padded_stride(nb_bins_total, sizeof(int));
+
+        const int nb_threads = omp_get_max_threads();
+        int *partial_histograms = calloc((size_t)nb_threads * stride, sizeof(*partial_histograms));
+        if (partial_histograms == NULL)
+        {
+                PRINT_ERROR("memory allocation failed for partial histograms");
+        }
+
+        const int nb_blocks = (array_len + BLOCK_LEN - 1) / BLOCK_LEN;
+
+#pragma omp parallel num_threads(nb_threads)
+        {
+                int *my_histograms = partial_histograms + (size_t)omp_get_thread_num() * stride;
+
+                int b;
+#pragma omp for schedule(static)
+                for (b = 0; b < nb_blocks; b++)
+                {
+                        const int block_start = b * BLOCK_LEN;
+                        const int block_end = (block_start + BLOCK_LEN < array_len) ? block_start + BLOCK_LEN : array_len;
+
+                        int s;
+                        for (s = 0; s < nb_specs; s++)
+                        {
+                                const struct s_histogram_binning binning = binnings[s];
+                                int *my_histogram = my_histograms + offsets[s];
+
+                                int i;
+                                for (i = block_start; i < block_end; i++)
+                                {
+                                        int j = histogram_binning_index(&binning, array[i]);
+                                        if (j >= 0)
+                                        {
+                                                my_histogram[j]++;
+                                        }
+                                }
+                        }
+                }
+
+                /* bins of all specs are reduced as one concatenated range */
+                int j;
+#pragma omp for schedule(static)
+                for (j = 0; j < nb_bins_total; j++)
+                {
+                        int sum = 0;
+                        int t;
+                        for (t = 0; t < nb_threads; t++)
+                        {
+                                sum += partial_histograms[(size_t)t * stride + j];
+                        }
+
+                        int s = 0;
+                        while (j >= offsets[s + 1])
+                        {
+                                s++;
+                        }
+                        histograms[s][j - offsets[s]] = sum;
+                }
+        }
+
+        free(partial_histograms);
+        free(offsets);
+        free(binnings);
+}
@@ -0,0 +1,21 @@
+#include <string.h>
+
+#include "histogram_engine.h"
+
+void naive_compute_histogram(const ELEMENT_TYPE *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec)
+{
+        const int nb_bins = p_spec->nb_bins;
+        const struct s_histogram_binning binning = histogram_binning(p_spec);
+
+        memset(histogram, 0, nb_bins * sizeof(*histogram));
+
+        int i;
+        for (i = 0; i < array_len; i++)
+        {
+                int j = histogram_binning_index(&binning, array[i]);
+                if (j >= 0)
+                {
+                        histogram[j]++;
+                }
+        }
+}
@@ -0,0 +1,175 @@
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "histogram_engine.h"
+
+/* bins of a partition: 2^15 ints (128 KiB) stay in L2 while the partition is counted */
+#define SLICE_BITS 15
+
+/* below this much memory for the dense per-thread partials, they stay cached enough for the omp engine to be faster */
+#define RADIX_MIN_DENSE_BYTES (16 << 20)
+
+/* bin indices staged per partition before being written out, one cache line */
+#define WC_BUFFER_LEN 16
+
+/* elements to partition: values binned on one axis, or (x, y) pairs binned into grid cells */
+struct s_radix_input
+{
+        const ELEMENT_TYPE *array;
+        const ELEMENT_TYPE *y_array;
+        struct s_histogram_binning binning;
+        struct s_histogram_binning y_binning;
+};
+
+/* the y_array test is loop-invariant, like the scale test, so the compiler unswitches the loops on it */
+static inline int radix_bin_index(const struct s_radix_input *p_input, int i)
+{
+        if (p_input->y_array != NULL)
+        {
+                return histogram_2d_cell_index(&p_input->binning, &p_input->y_binning, p_input->array[i], p_input->y_array[i]);
+        }
+        return histogram_binning_index(&p_input->binning, p_input->array[i]);
+}
+
+/*
+ * Two passes over the bins instead of one random increment per element:
+ * elements are first scattered, as bin indices, into partitions by the
+ * high bits of their bin index, then each partition is counted on its
+ * own slice of bins, which is cache-resident. The scatter goes through a
+ * one-line write-combining buffer per partition, so that it writes whole
+ * lines to each partition instead of single ints to as many pages.
+ *
+ * Each thread scatters its static chunk of the array: it counts its
+ * elements per partition first, and after a prefix sum over partitions
+ * then threads, every partition is contiguous in the scatter array. Each
+ * partition then belongs to one thread, which writes its bins directly.
+ */
+static void radix_count(const struct s_radix_input *p_input, int array_len, int *histogram, int nb_bins)
+{
+        const int nb_threads = omp_get_max_threads();
+        const int nb_partitions = ((nb_bins - 1) >> SLICE_BITS) + 1;
+
+        size_t *partition_offsets = calloc((size_t)nb_threads * nb_partitions, sizeof(*partition_offsets));
+        int *wc_buffers = malloc((size_t)nb_threads * nb_partitions * WC_BUFFER_LEN * sizeof(*wc_buffers));
+        int *wc_fills = calloc((size_t)nb_threads * nb_partitions, sizeof(*wc_fills));
+        if (partition_offsets == NULL || wc_buffers == NULL || wc_fills == NULL)
+        {
+                PRINT_ERROR("memory allocation failed");
+        }
+        int *scattered_bins = NULL;
+
+#pragma omp parallel num_threads(nb_threads)
+        {
+                const int thread_id = omp_get_thread_num();
+                const int chunk_start = (int)((long long)array_len * thread_id / nb_threads);
+                const int chunk_end = (int)((long long)array_len * (thread_id + 1) / nb_threads);
+                size_t *my_offsets = partition_offsets + (size_t)thread_id * nb_partitions;
+
+                int i;
+                for (i = chunk_start; i < chunk_end; i++)
+                {
+                        int j = radix_bin_index(p_input, i);
+                        if (j >= 0)
+                        {
+                                my_offsets[j >> SLICE_BITS]++;
+                        }
+                }
+
+#pragma omp barrier
+#pragma omp single
+                {
+                        /* counts become start offsets, partition-major so that each partition is contiguous */
+                        size_t offset = 0;
+                        int p;
+                        for (p = 0; p < nb_partitions; p++)
+                        {
+                                int t;
+                                for (t = 0; t < nb_threads; t++)
+                                {
+                                        size_t count = partition_offsets[(size_t)t * nb_partitions + p];
+                                        partition_offsets[(size_t)t * nb_partitions + p] = offset;
+                                        offset += count;
+                                }
+                        }
+
+                        scattered_bins = malloc((offset > 0 ? offset : 1) * sizeof(*scattered_bins));
+                        if (scattered_bins == NULL)
+                        {
+                                PRINT_ERROR("memory allocation failed for scattered bins");
+                        }
+                }
+
+                int *my_buffers = wc_buffers + (size_t)thread_id * nb_partitions * WC_BUFFER_LEN;
+                int *my_fills = wc_fills + (size_t)thread_id * nb_partitions;
+                for (i = chunk_start; i < chunk_end; i++)
+                {
+                        int j = radix_bin_index(p_input, i);
+                        if (j >= 0)
+                        {
+                                const int p = j >> SLICE_BITS;
+                                int *buffer = my_buffers + (size_t)p * WC_BUFFER_LEN;
+                                buffer[my_fills[p]++] = j;
+                                if (my_fills[p] == WC_BUFFER_LEN)
+                                {
+                                        memcpy(scattered_bins + my_offsets[p], buffer, WC_BUFFER_LEN * sizeof(*buffer));
+                                        my_offsets[p] += WC_BUFFER_LEN;
+                                        my_fills[p] = 0;
+                                }
+                        }
+                }
+
+                int p;
+                for (p = 0; p < nb_partitions; p++)
+                {
+                        memcpy(scattered_bins + my_offsets[p], my_buffers + (size_t)p * WC_BUFFER_LEN, my_fills[p] * sizeof(*my_buffers));
+                        my_offsets[p] += my_fills[p];
+                }
+
+                /* once scattered, the last thread's offset of each partition is where the partition ends */
+#pragma omp barrier
+#pragma omp for schedule(dynamic, 1)
+                for (p = 0; p < nb_partitions; p++)
+                {
+                        const int slice_start = p << SLICE_BITS;
+                        const int slice_len = (nb_bins - slice_start < (1 << SLICE_BITS)) ? nb_bins - slice_start : (1 << SLICE_BITS);
+                        memset(histogram + slice_start, 0, slice_len * sizeof(*histogram));
+
+                        const size_t start = (p == 0) ? 0 : partition_offsets[(size_t)(nb_threads - 1) * nb_partitions + p - 1];
+                        const size_t end = partition_offsets[(size_t)(nb_threads - 1) * nb_partitions + p];
+                        size_t k;
+                        for (k = start; k < end; k++)
+                        {
+                                histogram[scattered_bins[k]]++;
+                        }
+                }
+        }
+
+        free(scattered_bins);
+        free(wc_fills);
+        free(wc_buffers);
+        free(partition_offsets);
+}
+
+void radix_compute_histogram(const ELEMENT_TYPE *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec)
+{
+        const int nb_bins = p_spec->nb_bins;
+        const int nb_threads = omp_get_max_threads();
+        if ((size_t)nb_threads * nb_bins * sizeof(int) < RADIX_MIN_DENSE_BYTES || nb_bins <= (1 << SLICE_BITS))
+        {
+                omp_compute_histogram(array, array_len, histogram, p_spec);
+                return;
+        }
+
+        const struct s_radix_input input = {array, NULL, histogram_binning(p_spec), {0}};
+        radix_count(&input, array_len, histogram, nb_bins);
+}
+
+/* (x, y) pairs are partitioned by cell the same way, for grids too large for private per-thread grids */
+void radix_compute_histogram_2d(const ELEMENT_TYPE *x_array, const ELEMENT_TYPE *y_array, int array_len, int *histogram,
+                                const struct s_histogram_2d_spec *p_spec)
+{
+        const struct s_radix_input input = {x_array, y_array, histogram_binning(&p_spec->x), histogram_binning(&p_spec->y)};
+        radix_count(&input, array_len, histogram, p_spec->x.nb_bins * p_spec->y.nb_bins);
+}
@@ -0,0 +1,220 @@
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "histogram_engine.h"
+
+/* below this much memory for the dense per-thread partials, the omp engine is used as is */
+#define SPARSE_MIN_DENSE_BYTES (8 << 20)
+
+/* tables are used only when they take at most this fraction of the dense partials */
+#define SPARSE_MAX_MEMORY_RATIO 4
+
+#define SAMPLE_LEN 4096
+#define SAMPLE_TABLE_CAPACITY (2 * SAMPLE_LEN)
+#define MIN_TABLE_CAPACITY 1024
+
+#define EMPTY_KEY (-1)
+
+/* open addressing with linear probing, keyed by bin index */
+struct s_bin_table
+{
+        int *keys;
+        int *counts;
+        int capacity;
+        int size;
+};
+
+static inline uint32_t bin_hash(int bin)
+{
+        return (uint32_t)bin * 2654435761u;
+}
+
+static void bin_table_init(struct s_bin_table *p_table, int capacity)
+{
+        p_table->keys = malloc(capacity * sizeof(*p_table->keys));
+        p_table->counts = calloc(capacity, sizeof(*p_table->counts));
+        if (p_table->keys == NULL || p_table->counts == NULL)
+        {
+                PRINT_ERROR("memory allocation failed for bin table");
+        }
+        memset(p_table->keys, 0xff, capacity * sizeof(*p_table->keys));
+        p_table->capacity = capacity;
+        p_table->size = 0;
+}
+
+static void bin_table_delete(struct s_bin_table *p_table)
+{
+        free(p_table->keys);
+        free(p_table->counts);
+        p_table->keys = NULL;
+        p_table->counts = NULL;
+}
+
+static void bin_table_add(struct s_bin_table *p_table, int bin, int count);
+
+static void bin_table_grow(struct s_bin_table *p_table)
+{
+        struct s_bin_table old_table = *p_table;
+        bin_table_init(p_table, 2 * old_table.capacity);
+
+        int e;
+        for (e = 0; e < old_table.capacity; e++)
+        {
+                if (old_table.keys[e] != EMPTY_KEY)
+                {
+                        bin_table_add(p_table, old_table.keys[e], old_table.counts[e]);
+                }
+        }
+        bin_table_delete(&old_table);
+}
+
+static void bin_table_add(struct s_bin_table *p_table, int bin, int count)
+{
+        const uint32_t mask = p_table->capacity - 1;
+        uint32_t e = bin_hash(bin) & mask;
+        while (p_table->keys[e] != bin)
+        {
+                if (p_table->keys[e] == EMPTY_KEY)
+                {
+                        if (2 * (p_table->size + 1) > p_table->capacity)
+                        {
+                                bin_table_grow(p_table);
+                                bin_table_add(p_table, bin, count);
+                                return;
+                        }
+                        p_table->keys[e] = bin;
+                        p_table->size++;
+                        break;
+                }
+                e = (e + 1) & mask;
+        }
+        p_table->counts[e] += count;
+}
+
+static int next_power_of_two(long long value)
+{
+        int capacity = MIN_TABLE_CAPACITY;
+        while (capacity < value && capacity < (1 << 30))
+        {
+                capacity *= 2;
+        }
+        return capacity;
+}
+
+/*
+ * Number of occupied bins, estimated from an evenly spaced sample with the
+ * Chao1 estimator: bins seen once or twice in the sample tell how many
+ * were missed. Without doubletons the sample says nothing about the
+ * missing bins, and every element is assumed to land in its own bin.
+ */
+static long long estimate_occupied_bins(const ELEMENT_TYPE *array, int array_len, const struct s_histogram_binning *p_binning)
+{
+        const int sample_len = (array_len < SAMPLE_LEN) ? array_len : SAMPLE_LEN;
+        const long long upper_estimate = (array_len < p_binning->nb_bins) ? array_len : p_binning->nb_bins;
+        if (sample_len == array_len)
+        {
+                return upper_estimate;
+        }
+
+        struct s_bin_table sample_table;
+        bin_table_init(&sample_table, SAMPLE_TABLE_CAPACITY);
+        const int stride = array_len / sample_len;
+        int i;
+        for (i = 0; i < sample_len; i++)
+        {
+                int j = histogram_binning_index(p_binning, array[(size_t)i * stride]);
+                if (j >= 0)
+                {
+                        bin_table_add(&sample_table, j, 1);
+                }
+        }
+
+        long long nb_singletons = 0;
+        long long nb_doubletons = 0;
+        int e;
+        for (e = 0; e < sample_table.capacity; e++)
+        {
+                nb_singletons += (sample_table.counts[e] == 1);
+                nb_doubletons += (sample_table.counts[e] == 2);
+        }
+        const long long nb_seen = sample_table.size;
+        bin_table_delete(&sample_table);
+
+        if (nb_doubletons == 0)
+        {
+                return (nb_singletons == 0) ? nb_seen : upper_estimate;
+        }
+        long long estimate = nb_seen + nb_singletons * nb_singletons / (2 * nb_doubletons);
+        return (estimate < upper_estimate) ? estimate : upper_estimate;
+}
+
+/*
+ * For very many bins, dense per-thread partials cost nb_threads * nb_bins
+ * ints, most of them zero when few bins are hit. Each thread then counts
+ * into a hash table sized from the estimated number of occupied bins
+ * (grown if the estimate was short), and the tables are added into the
+ * result at the end. When the partials are small, or the data hits a
+ * large share of the bins, the dense omp engine is used instead.
+ */
+void sparse_compute_histogram(const ELEMENT_TYPE *array, int array_len, int *histogram, const struct s_histogram_spec *p_spec)
+{
+        const int nb_bins = p_spec->nb_bins;
+        const struct s_histogram_binning binning = histogram_binning(p_spec);
+        const int nb_threads = omp_get_max_threads();
+
+        if ((size_t)nb_threads * nb_bins * sizeof(int) < SPARSE_MIN_DENSE_BYTES)
+        {
+                omp_compute_histogram(array, array_len, histogram, p_spec);
+                return;
+        }
+
+        /* any thread may see every occupied bin; tables stay at most half full */
+        const long long nb_occupied_bins = estimate_occupied_bins(array, array_len, &binning);
+        const int capacity = next_power_of_two(2 * nb_occupied_bins);
+
+        /* a table entry holds a key and a count, twice a dense bin */
+        if ((long long)capacity * 2 * SPARSE_MAX_MEMORY_RATIO > nb_bins)
+        {
+                omp_compute_histogram(array, array_len, histogram, p_spec);
+                return;
+        }
+
+#pragma omp parallel num_threads(nb_threads)
+        {
+                struct s_bin_table my_table;
+                bin_table_init(&my_table, capacity);
+
+                int i;
+#pragma omp for schedule(static)
+                for (i = 0; i < array_len; i++)
+                {
+                        int j = histogram_binning_index(&binning, array[i]);
+                        if (j >= 0)
+                        {
+                                bin_table_add(&my_table, j, 1);
+                        }
+                }
+
+                int j;
+#pragma omp for schedule(static)
+                for (j = 0; j < nb_bins; j++)
+                {
+                        histogram[j] = 0;
+                }
+
+                int e;
+                for (e = 0; e < my_table.capacity; e++)
+                {
+                        if (my_table.keys[e] != EMPTY_KEY)
+                        {
+#pragma omp atomic
+                                histogram[my_table.keys[e]] += my_table.counts[e];
+                        }
+                }
+
+                bin_table_delete(&my_table);
+        }
+}
@@ -0,0 +1,185 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "histogram.h"
+
+struct s_histogram_window
+{
+        struct s_histogram_spec spec;
+        struct s_histogram_binning binning;
+        size_t window_len;
+        size_t head;
+        uint64_t nb_pushed;
+        int32_t *ring;
+        uint32_t *counts;
+};
+
+/*
+ * slots nb_bins and nb_bins + 1 count underflow and overflow; the extra slot
+ * nb_bins + 2 holds NaN and the not yet filled part of the ring, so that
+ * eviction never has to test whether the window is full
+ */
+#define UNDERFLOW_SLOT(P_WINDOW) ((P_WINDOW)->spec.nb_bins)
+#define OVERFLOW_SLOT(P_WINDOW) ((P_WINDOW)->spec.nb_bins + 1)
+#define EMPTY_SLOT(P_WINDOW) ((P_WINDOW)->spec.nb_bins + 2)
+#define NB_SLOTS(P_WINDOW) ((P_WINDOW)->spec.nb_bins + 3)
+
+int histogram_window_init(struct s_histogram_window **pp_window, const struct s_histogram_spec *p_spec, size_t window_len)
+{
+        if (!histogram_spec_is_valid(p_spec) || window_len < 1 || window_len > UINT32_MAX)
+        {
+                return -1;
+        }
+
+        struct s_histogram_window *p_window = calloc(1, sizeof(*p_window));
+        if (p_window == NULL)
+        {
+                return -1;
+        }
+
+        p_window->spec = *p_spec;
+        p_window->binning = histogram_binning(p_spec);
+        p_window->window_len = window_len;
+        p_window->ring = malloc(window_len * sizeof(*p_window->ring));
+        p_window->counts = malloc(NB_SLOTS(p_window) * sizeof(*p_window->counts));
+        if (p_window->ring == NULL || p_window->counts == NULL)
+        {
+                free(p_window->ring);
+                free(p_window->counts);
+                free(p_window);
+                return -1;
+        }
+
+        histogram_window_reset(p_window);
+        *pp_window = p_window;
+        return 0;
+}
+
+void histogram_window_delete(struct s_histogram_window **pp_window)
+{
+        struct s_histogram_window *p_window = *pp_window;
+        if (p_window == NULL)
+        {
+                return;
+        }
+        free(p_window->ring);
+        free(p_window->counts);
+        free(p_window);
+        *pp_window = NULL;
+}
+
+void histogram_window_reset(struct s_histogram_window *p_window)
+{
+        const int32_t empty_slot = EMPTY_SLOT(p_window);
+        size_t i;
+        for (i = 0; i < p_window->window_len; i++)
+        {
+                p_window->ring[i] = empty_slot;
+        }
+        memset(p_window->counts, 0, NB_SLOTS(p_window) * sizeof(*p_window->counts));
+        p_window->counts[empty_slot] = p_window->window_len;
+        p_window->head = 0;
+        p_window->nb_pushed = 0;
+}
+
+static inline int32_t window_slot(const struct s_histogram_window *p_window, ELEMENT_TYPE value)
+{
+        int j = histogram_binning_slot(&p_window->binning, value);
+        return (j >= 0) ? j : EMPTY_SLOT(p_window);
+}
+
+void histogram_window_push(struct s_histogram_window *p_window, ELEMENT_TYPE value)
+{
+        const int32_t slot = window_slot(p_window, value);
+        int32_t *p_entry = &p_window->ring[p_window->head];
+
+        p_window->counts[*p_entry]--;
+        *p_entry = slot;
+        p_window->counts[slot]++;
+
+        p_window->head++;
+        if (p_window->head == p_window->window_len)
+        {
+                p_window->head = 0;
+        }
+        p_window->nb_pushed++;
+}
+
+void histogram_window_push_block(struct s_histogram_window *p_window, const ELEMENT_TYPE *array, size_t array_len)
+{
+        const size_t window_len = p_window->window_len;
+        uint32_t *counts = p_window->counts;
+
+        /* only the last window_len samples of a large block survive: rebuild from them */
+        if (array_len >= window_len)
+        {
+                const uint64_t nb_pushed = p_window->nb_pushed + array_len;
+                const ELEMENT_TYPE *tail = array + (array_len - window_len);
+
+                memset(counts, 0, NB_SLOTS(p_window) * sizeof(*counts));
+                size_t i;
+                for (i = 0; i < window_len; i++)
+                {
+                        int32_t slot = window_slot(p_window, tail[i]);
+                        p_window->ring[i] = slot;
+                        counts[slot]++;
+                }
+                p_window->head = 0;
+                p_window->nb_pushed = nb_pushed;
+                return;
+        }
+
+        /* otherwise walk the ring in contiguous segments, without a wrap test per sample */
+        p_window->nb_pushed += array_len;
+        while (array_len > 0)
+        {
+                size_t segment_len = window_len - p_window->head;
+                if (segment_len > array_len)
+                {
+                        segment_len = array_len;
+                }
+
+                int32_t *ring = p_window->ring + p_window->head;
+                size_t i;
+                for (i = 0; i < segment_len; i++)
+                {
+                        int32_t slot = window_slot(p_window, array[i]);
+                        counts[ring[i]]--;
+                        ring[i] = slot;
+                        counts[slot]++;
+                }
+
+                p_window->head += segment_len;
+                if (p_window->head == window_len)
+                {
+                        p_window->head = 0;
+                }
+                array += segment_len;
+                array_len -= segment_len;
+        }
+}
+
+size_t histogram_window_len(const struct s_histogram_window *p_window)
+{
+        return p_window->window_len;
+}
+
+size_t histogram_window_fill(const struct s_histogram_window *p_window)
+{
+        return (p_window->nb_pushed < p_window->window_len) ? (size_t)p_window->nb_pushed : p_window->window_len;
+}
+
+const uint32_t *histogram_window_counts(const struct s_histogram_window *p_window)
+{
+        return p_window->counts;
+}
+
+uint32_t histogram_window_underflow(const struct s_histogram_window *p_window)
+{
+        return p_window->counts[UNDERFLOW_SLOT(p_window)];
+}
+
+uint32_t histogram_window_overflow(const struct s_histogram_window *p_window)
+{
+        return p_window->counts[OVERFLOW_SLOT(p_window)];
+}
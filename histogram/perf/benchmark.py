@@ -4,7 +4,7 @@ import io
 import re
 from typing import List, Dict, Any
 
-EXECUTABLES: List[str] = ["./histogram", "./histogram_omp", "./histogram_cuda"]
+EXECUTABLE: str = "./histogram"
 
 ARRAY_LENS: List[int] = [10**2,
     10**3,
@@ -15,19 +15,24 @@ ARRAY_LENS: List[int] = [10**2,
 
 NB_BINS: int = 5
 NB_REPEAT: int = 10
+NB_WARMUP: int = 1
 OUTPUT_CSV_FILE: str = "./perf/benchmark_results.csv"
 
 def run_program_and_parse(executable: str, array_len: int, nb_bins: int, nb_repeat: int) -> pd.DataFrame:
     """
-    Exécute un programme avec les paramètres donnés et retourne ses données de timing sous forme de DataFrame.
+    Exécute tous les moteurs disponibles (--engine all) sur les mêmes données et retourne
+    leurs données de timing sous forme de DataFrame.
     """
     print(f"-> Exécution de {executable} avec --array-len {array_len}...")
     
     command: List[str] = [
         executable,
+        f"--engine", "all",
         f"--array-len", str(array_len),
         f"--nb-bins", str(nb_bins),
-        f"--nb-repeat", str(nb_repeat)
+        f"--nb-repeat", str(nb_repeat),
+        f"--warmup", str(NB_WARMUP),
+        f"--summary"
     ]
     
     try:
@@ -46,8 +51,6 @@ def run_program_and_parse(executable: str, array_len: int, nb_bins: int, nb_repe
 
         df: pd.DataFrame = pd.read_csv(io.StringIO(output_data))
         
-        df['executable'] = executable
-        
         return df
         
     except subprocess.CalledProcessError as e:
@@ -70,10 +73,9 @@ def main():
     print("--- ⏱️ Début de la comparaison des performances ---")
 
     for array_len in ARRAY_LENS:
-        for executable in EXECUTABLES:
-            df_timing = run_program_and_parse(executable, array_len, NB_BINS, NB_REPEAT)
-            if not df_timing.empty:
-                all_data.append(df_timing)
+        df_timing = run_program_and_parse(EXECUTABLE, array_len, NB_BINS, NB_REPEAT)
+        if not df_timing.empty:
+            all_data.append(df_timing)
 
     if not all_data:
         print("\n[FIN] Aucune donnée n'a été collectée. Veuillez vérifier les chemins et les permissions des exécutables.")
@@ -83,22 +85,23 @@ def main():
     
     print("\n--- 📊 Analyse des données de timing ---")
 
-    filtered_df: pd.DataFrame = raw_df[raw_df['rep'] != 0].copy()
-
-    filtered_df['timing'] = pd.to_numeric(filtered_df['timing'])
-    
-    average_performance: pd.DataFrame = filtered_df.groupby(['executable', 'array_len']).agg(
-        average_timing=('timing', 'mean'),
-        nb_bins=('nb_bins', 'first'),
-        nb_repeat=('nb_repeat', 'first')
-    ).reset_index()
-
-    final_df: pd.DataFrame = average_performance[[
-        'executable', 
+    # les itérations de chauffe sont déjà écartées par le programme (--warmup)
+    final_df: pd.DataFrame = raw_df.rename(columns={
+        'mean': 'average_timing',
+        'median': 'median_timing',
+        'p95': 'p95_timing',
+        'stddev': 'stddev_timing'
+    })[[
+        'engine', 
         'array_len', 
         'nb_bins', 
         'nb_repeat', 
-        'average_timing'
+        'average_timing',
+        'median_timing',
+        'p95_timing',
+        'stddev_timing',
+        'elements_per_s',
+        'gb_per_s'
     ]]
     
     final_df.rename(columns={'array_len': 'input_size'}, inplace=True)
@@ -4,7 +4,7 @@ import io
 import time
 import os
 
-CUDA_SOURCE_FILE = "./histogram_cuda.cu"
+PROGRAM = "./histogram"
 EXECUTABLE_PREFIX = "./histogram_cuda" 
 
 BLOCK_SIZES = [
@@ -32,35 +32,33 @@ OUTPUT_FILENAME = "./perf/block_size_optimization_results.csv"
 
 
 def compile_cuda(block_size):
-    """ Compile le source CUDA en définissant BLOCK_SIZE via l'option -D. """
+    """ Recompile le programme (moteur CUDA inclus) en définissant BLOCK_SIZE via make. """
     exe_name = f"{EXECUTABLE_PREFIX}_{block_size}"
     
     compile_command = [
-        "nvcc",
-        f"-DBLOCK_SIZE={block_size}",
-        f"-arch={ARCH_FLAG}",
-        "-g", "-O3",
-        CUDA_SOURCE_FILE,
-        "-o", exe_name,
-        "-lcudart", "-lm"
+        "make", "-B", "histogram",
+        f"BLOCK_SIZE={block_size}",
+        f"CUDA_ARCH={ARCH_FLAG}"
     ]
     
     print(f"\nCompilation pour BLOCK_SIZE={block_size}...")
     try:
         subprocess.run(compile_command, check=True, capture_output=True)
+        os.rename(PROGRAM, exe_name)
         return exe_name
     except subprocess.CalledProcessError as e:
         print(f"ERREUR DE COMPILATION pour BLOCK_SIZE={block_size}:")
         print(e.stderr.decode())
         return None
     except FileNotFoundError:
-        print("ERREUR : Le compilateur 'nvcc' ou le fichier source est introuvable.")
+        print("ERREUR : 'make' ou le programme compilé est introuvable.")
         return None
 
 def run_benchmark(executable, array_len, nb_bins, nb_repeat, block_size):
     """ Exécute le programme et retourne le temps moyen des 5 dernières itérations. """
     command = [
         executable,
+        "--engine", "cuda",
         "--array-len", str(array_len),
         "--nb-bins", str(nb_bins),
         "--nb-repeat", str(nb_repeat)
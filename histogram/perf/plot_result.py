@@ -16,6 +16,10 @@ def plot_performance(csv_file: str, output_file: str):
         print(f"[ERREUR] Le fichier CSV '{csv_file}' est introuvable. Veuillez vous assurer que le chemin est correct.")
         return
 
+    # les anciens résultats identifient le programme par 'executable', les nouveaux par 'engine'
+    if 'engine' in df.columns:
+        df = df.rename(columns={'engine': 'executable'})
+
     required_cols = ['executable', 'input_size', 'average_timing']
     if not all(col in df.columns for col in required_cols):
         print(f"[ERREUR] Le fichier CSV doit contenir les colonnes : {required_cols}")
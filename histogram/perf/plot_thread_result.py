@@ -6,7 +6,8 @@ import matplotlib.pyplot as plt
 import seaborn as sns
 from typing import List
 
-EXECUTABLE: str = "./histogram_omp"
+EXECUTABLE: str = "./histogram"
+ENGINE: str = "omp"
 
 ARRAY_LENS: List[int] = [10**2,
     10**3,
@@ -18,6 +19,7 @@ NB_THREADS: List[int] = [1, 2, 4, 8, 12, 16, 20, 24]
 
 NB_BINS: int = 5
 NB_REPEAT: int = 10 
+NB_WARMUP: int = 1
 OUTPUT_CSV_FILE: str = "./perf/omp_scaling_data.csv"
 OUTPUT_GRAPH_FILE: str = "./perf/omp_scaling_graph.png"
 
@@ -32,9 +34,12 @@ def run_program_and_parse(executable: str, array_len: int, nb_threads: int) -> p
 
     command: List[str] = [
         executable,
+        f"--engine", ENGINE,
         f"--array-len", str(array_len),
         f"--nb-bins", str(NB_BINS),
-        f"--nb-repeat", str(NB_REPEAT)
+        f"--nb-repeat", str(NB_REPEAT),
+        f"--warmup", str(NB_WARMUP),
+        f"--summary"
     ]
     
     try:
@@ -118,15 +123,16 @@ def main():
         
     raw_df: pd.DataFrame = pd.concat(all_data, ignore_index=True)
     
-    print("\n--- Analyse des données de timing (filtrage de rep=0) ---")
-
-    filtered_df: pd.DataFrame = raw_df[raw_df['rep'] != 0].copy()
-    filtered_df['timing'] = pd.to_numeric(filtered_df['timing'])
-    
-    average_performance: pd.DataFrame = filtered_df.groupby(['executable', 'array_len', 'nb_threads']).agg(
-        average_timing=('timing', 'mean'),
-        samples_for_avg=('rep', 'count') 
-    ).reset_index()
+    print("\n--- Analyse des données de timing (chauffe écartée par --warmup) ---")
+
+    average_performance: pd.DataFrame = raw_df.rename(columns={
+        'mean': 'average_timing',
+        'median': 'median_timing',
+        'p95': 'p95_timing',
+        'stddev': 'stddev_timing',
+        'nb_samples': 'samples_for_avg'
+    })[['executable', 'array_len', 'nb_threads', 'average_timing', 'median_timing',
+        'p95_timing', 'stddev_timing', 'samples_for_avg']]
 
     average_performance['array_len'] = pd.to_numeric(average_performance['array_len'])
     average_performance['nb_threads'] = pd.to_numeric(average_performance['nb_threads'])
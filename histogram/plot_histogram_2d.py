@@ -0,0 +1,16 @@
+#!/usr/bin/env python3
+import matplotlib as mpl
+import numpy as np
+import seaborn as sns
+
+x_bins = np.genfromtxt("x_bins.csv")
+y_bins = np.genfromtxt("y_bins.csv")
+histogram = np.atleast_2d(np.genfromtxt("run_histogram_2d.csv", delimiter=","))
+
+sns.set_theme()
+fig, ax = mpl.pyplot.subplots()
+mesh = ax.pcolormesh(x_bins, y_bins, histogram, cmap="viridis")
+fig.colorbar(mesh, ax=ax, label="Count")
+ax.set_xlabel("x")
+ax.set_ylabel("y")
+mpl.pyplot.show()
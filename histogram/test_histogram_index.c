@@ -0,0 +1,242 @@
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "histogram.h"
+
+static int nb_failures = 0;
+
+#define EXPECT_COUNT(EXPR, EXPECTED)                                                                                   \
+        do                                                                                                             \
+        {                                                                                                              \
+                uint64_t value = (EXPR);                                                                               \
+                if (value != (uint64_t)(EXPECTED))                                                                     \
+                {                                                                                                      \
+                        fprintf(stderr, "%s:%d - %s = %llu, expected %llu\n", __FILE__, __LINE__, #EXPR,               \
+                                (unsigned long long)value, (unsigned long long)(EXPECTED));                            \
+                        nb_failures++;                                                                                 \
+                }                                                                                                      \
+        } while (0)
+
+#define EXPECT_TRUE(COND)                                                                                              \
+        do                                                                                                             \
+        {                                                                                                              \
+                if (!(COND))                                                                                           \
+                {                                                                                                      \
+                        fprintf(stderr, "%s:%d - %s is false\n", __FILE__, __LINE__, #COND);                           \
+                        nb_failures++;                                                                                 \
+                }                                                                                                      \
+        } while (0)
+
+/* 10 bins of width 1 over [0, 10], bin j holding j + 1 samples */
+static void test_linear_range_count(void)
+{
+        const struct s_histogram_spec spec = {10, 0.0, 10.0, histogram_scale_linear, 0};
+        struct s_histogram_index *p_index = NULL;
+        if (histogram_index_init(&p_index, &spec) != 0)
+        {
+                PRINT_ERROR("histogram index initialization failed");
+        }
+        int counts[10];
+        int j;
+        for (j = 0; j < 10; j++)
+        {
+                counts[j] = j + 1;
+        }
+        histogram_index_build_int(p_index, counts);
+
+        EXPECT_COUNT(histogram_index_total(p_index), 55);
+        EXPECT_COUNT(histogram_index_range_count(p_index, 0.0, 10.0), 55);
+        EXPECT_COUNT(histogram_index_range_count(p_index, 2.5, 4.5), 3 + 4 + 5);
+
+        /* entirely out of range */
+        EXPECT_COUNT(histogram_index_range_count(p_index, 11.0, 20.0), 0);
+        EXPECT_COUNT(histogram_index_range_count(p_index, 10.0, 20.0), 0);
+        EXPECT_COUNT(histogram_index_range_count(p_index, -20.0, -11.0), 0);
+        EXPECT_COUNT(histogram_index_range_count(p_index, -INFINITY, -1.0), 0);
+        EXPECT_COUNT(histogram_index_range_count(p_index, 1e30, INFINITY), 0);
+
+        /* partly out of range: clamped to the first or last bin */
+        EXPECT_COUNT(histogram_index_range_count(p_index, -5.0, 1.5), 1 + 2);
+        EXPECT_COUNT(histogram_index_range_count(p_index, 8.5, 50.0), 9 + 10);
+        EXPECT_COUNT(histogram_index_range_count(p_index, -INFINITY, INFINITY), 55);
+
+        /* empty or invalid ranges */
+        EXPECT_COUNT(histogram_index_range_count(p_index, 5.0, 4.0), 0);
+        EXPECT_COUNT(histogram_index_range_count(p_index, NAN, 4.0), 0);
+
+        histogram_index_delete(&p_index);
+}
+
+static void test_loglinear_range_count(void)
+{
+        const struct s_histogram_spec spec = {HISTOGRAM_LOGLINEAR_NB_BINS(0), 0.0, 1.0, histogram_scale_loglinear, 0};
+        struct s_histogram_index *p_index = NULL;
+        if (histogram_index_init(&p_index, &spec) != 0)
+        {
+                PRINT_ERROR("histogram index initialization failed");
+        }
+        int *counts = calloc(spec.nb_bins, sizeof(*counts));
+        if (counts == NULL)
+        {
+                PRINT_ERROR("memory allocation failed");
+        }
+        /* one sample in [1, 2[ and one in [4, 8[ */
+        counts[127] = 1;
+        counts[129] = 1;
+        histogram_index_build_int(p_index, counts);
+
+        EXPECT_COUNT(histogram_index_range_count(p_index, 1.0, 7.0), 2);
+        EXPECT_COUNT(histogram_index_range_count(p_index, -10.0, -1.0), 0);
+        EXPECT_COUNT(histogram_index_range_count(p_index, INFINITY, INFINITY), 0);
+        EXPECT_COUNT(histogram_index_range_count(p_index, -10.0, 1.5), 1);
+
+        free(counts);
+        histogram_index_delete(&p_index);
+}
+
+/* 1-based rank of the q-quantile among nb_samples sorted samples */
+static int reference_rank(double q, int nb_samples)
+{
+        int rank = (int)ceil(q * nb_samples);
+        return (rank < 1) ? 1 : rank;
+}
+
+/* 13 bins, several of them empty, against the bins of the samples in sorted order */
+static void test_quantile(void)
+{
+        const struct s_histogram_spec spec = {13, 0.0, 13.0, histogram_scale_linear, 0};
+        struct s_histogram_index *p_index = NULL;
+        if (histogram_index_init(&p_index, &spec) != 0)
+        {
+                PRINT_ERROR("histogram index initialization failed");
+        }
+        const int counts[13] = {0, 3, 1, 0, 0, 7, 2, 0, 1, 4, 0, 5, 0};
+        histogram_index_build_int(p_index, counts);
+
+        int sorted_bins[23];
+        int nb_samples = 0;
+        int j;
+        for (j = 0; j < 13; j++)
+        {
+                int c;
+                for (c = 0; c < counts[j]; c++)
+                {
+                        sorted_bins[nb_samples++] = j;
+                }
+        }
+        EXPECT_COUNT(histogram_index_total(p_index), nb_samples);
+
+        int k;
+        for (k = 0; k <= 100; k++)
+        {
+                const double q = k / 100.0;
+                const int rank = reference_rank(q, nb_samples);
+                const int expected_bin = sorted_bins[rank - 1];
+                EXPECT_COUNT(histogram_index_quantile_bin(p_index, q), expected_bin);
+
+                /* interpolated inside the bin, by the rank of the sample among those of its bin */
+                int nb_before = 0;
+                while (sorted_bins[nb_before] != expected_bin)
+                {
+                        nb_before++;
+                }
+                const double expected = expected_bin + (double)(rank - nb_before) / counts[expected_bin];
+                EXPECT_TRUE(histogram_index_quantile(p_index, q) == expected);
+        }
+
+        /* q = 0 is the first sample, q = 1 the last one, and q is clamped to [0, 1] */
+        EXPECT_COUNT(histogram_index_quantile_bin(p_index, 0.0), 1);
+        EXPECT_COUNT(histogram_index_quantile_bin(p_index, 1.0), 11);
+        EXPECT_COUNT(histogram_index_quantile_bin(p_index, -1.0), 1);
+        EXPECT_COUNT(histogram_index_quantile_bin(p_index, 2.0), 11);
+        EXPECT_TRUE(histogram_index_quantile(p_index, 1.0) == 12.0);
+
+        histogram_index_delete(&p_index);
+}
+
+/* an empty index has no quantile; updates then keep every prefix in step with the counts */
+static void test_update(void)
+{
+        const struct s_histogram_spec spec = {7, 0.0, 7.0, histogram_scale_linear, 0};
+        struct s_histogram_index *p_index = NULL;
+        if (histogram_index_init(&p_index, &spec) != 0)
+        {
+                PRINT_ERROR("histogram index initialization failed");
+        }
+        EXPECT_COUNT(histogram_index_total(p_index), 0);
+        EXPECT_COUNT(histogram_index_quantile_bin(p_index, 0.5), -1);
+        EXPECT_TRUE(isnan(histogram_index_quantile(p_index, 0.5)));
+
+        uint64_t counts[7] = {0};
+        const int updates[][2] = {{3, 4}, {0, 1}, {6, 2}, {3, -3}, {5, 6}, {0, -1}, {1, 2}};
+        int u;
+        for (u = 0; u < (int)(sizeof(updates) / sizeof(updates[0])); u++)
+        {
+                histogram_index_update(p_index, updates[u][0], updates[u][1]);
+                counts[updates[u][0]] += updates[u][1];
+
+                uint64_t prefix = 0;
+                int j;
+                for (j = 0; j <= 7; j++)
+                {
+                        EXPECT_COUNT(histogram_index_prefix_count(p_index, j), prefix);
+                        if (j < 7)
+                        {
+                                prefix += counts[j];
+                        }
+                }
+        }
+
+        /* counts are now {0, 2, 0, 1, 0, 6, 2} */
+        EXPECT_COUNT(histogram_index_total(p_index), 11);
+        EXPECT_COUNT(histogram_index_range_count(p_index, 1.0, 3.5), 3);
+        EXPECT_COUNT(histogram_index_quantile_bin(p_index, 0.0), 1);
+        EXPECT_COUNT(histogram_index_quantile_bin(p_index, 0.25), 3);
+        EXPECT_COUNT(histogram_index_quantile_bin(p_index, 0.5), 5);
+        EXPECT_COUNT(histogram_index_quantile_bin(p_index, 1.0), 6);
+
+        histogram_index_delete(&p_index);
+}
+
+/* the last loglinear bin ends at +inf, but its samples and quantiles are finite */
+static void test_loglinear_last_bin_quantile(void)
+{
+        const struct s_histogram_spec spec = {HISTOGRAM_LOGLINEAR_NB_BINS(0), 0.0, 1.0, histogram_scale_loglinear, 0};
+        struct s_histogram_index *p_index = NULL;
+        if (histogram_index_init(&p_index, &spec) != 0)
+        {
+                PRINT_ERROR("histogram index initialization failed");
+        }
+        const int last_bin = spec.nb_bins - 1;
+        histogram_index_update(p_index, last_bin, 2);
+
+        EXPECT_COUNT(histogram_index_quantile_bin(p_index, 1.0), last_bin);
+        const double lower_edge = histogram_bin_edge(&spec, last_bin);
+        double q;
+        for (q = 0.0; q <= 1.0; q += 0.5)
+        {
+                const double value = histogram_index_quantile(p_index, q);
+                EXPECT_TRUE(value >= lower_edge && value <= FLT_MAX);
+        }
+
+        histogram_index_delete(&p_index);
+}
+
+int main(void)
+{
+        test_linear_range_count();
+        test_loglinear_range_count();
+        test_quantile();
+        test_update();
+        test_loglinear_last_bin_quantile();
+
+        if (nb_failures > 0)
+        {
+                fprintf(stderr, "%d failure(s)\n", nb_failures);
+                return EXIT_FAILURE;
+        }
+        printf("test_histogram_index: ok\n");
+        return EXIT_SUCCESS;
+}
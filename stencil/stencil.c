@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <float.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,45 +7,213 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <omp.h>
+
+#include "bench.h"
+#include "perf_counters.h"
+#include "phase_timer.h"
+
 #define ELEMENT_TYPE float
 
 #define DEFAULT_MESH_WIDTH 2000
 #define DEFAULT_MESH_HEIGHT 1000
 #define DEFAULT_NB_ITERATIONS 100
+#define DEFAULT_MESH_WIDTH_3D 512
+#define DEFAULT_MESH_HEIGHT_3D 512
+#define DEFAULT_MESH_DEPTH 128
+#define DEFAULT_NB_ITERATIONS_3D 10
 #define DEFAULT_NB_REPEAT 10
+#define DEFAULT_NB_WARMUP 0
+#define DEFAULT_MIN_TIME 0.0
+#define DEFAULT_ENSEMBLE_SIZE 1
 
 #define STENCIL_WIDTH 3
 #define STENCIL_HEIGHT 3
 
+/* the 3D kernels reach one cell away in each direction */
+#define STENCIL_RADIUS 1
+
+/*
+ * x/y tile of the blocked engine, 0 for whole rows: 3 planes of a 512x32
+ * tile with halo take 209 KiB. Narrower tiles cut rows into pieces too
+ * short for the hardware prefetcher and touch a new page every few lines.
+ */
+#define DEFAULT_TILE_WIDTH 0
+#define DEFAULT_TILE_HEIGHT 32
+
 #define TOP_BOUNDARY_VALUE 10
 #define BOTTOM_BOUNDARY_VALUE 5
 #define LEFT_BOUNDARY_VALUE -10
 #define RIGHT_BOUNDARY_VALUE -5
+#define FRONT_BOUNDARY_VALUE 2
+#define BACK_BOUNDARY_VALUE -2
 
 #define MAX_DISPLAY_COLUMNS 20
 #define MAX_DISPLAY_LINES 100
 
 #define EPSILON 1e-3
 
+/* tiles of the active engine; a cell's neighbourhood spans at most its tile and the 8 around it */
+#define TILE_WIDTH 64
+#define TILE_HEIGHT 16
+
+/* nominal memory traffic of one cell update: one read and one write */
+#define BYTES_PER_CELL_UPDATE (2 * sizeof(ELEMENT_TYPE))
+
+#define NB_TAPS (STENCIL_WIDTH * STENCIL_HEIGHT)
+
+/* variable coefficients: the media is a grid of regions, each with its own coefficients */
+#define REGION_GRID_WIDTH 4
+#define REGION_GRID_HEIGHT 4
+#define NB_REGIONS (REGION_GRID_WIDTH * REGION_GRID_HEIGHT)
+
+/* columns of a tile of the variable-coefficient sweeps: the 9 coefficient rows and 3 mesh rows of a tile row take 24 KiB */
+#define VARIABLE_TILE_WIDTH 512
+
+/* copies timed to measure the bandwidth the machine reaches on the same footprint, the best one kept */
+#define NB_BANDWIDTH_COPIES 5
+
 static const ELEMENT_TYPE stencil_coefs[STENCIL_HEIGHT * STENCIL_WIDTH] =
     {
         0.25 / 3,  0.50 / 3, 0.25 / 3,
         0.50 / 3, -1.00,     0.50 / 3,
         0.25 / 3,  0.50 / 3, 0.25 / 3};
 
+/* like the 2D stencil, each cell becomes a weighted mean of its neighbours */
+static const ELEMENT_TYPE stencil_7_coefs[2] = {-1.00, 1.0 / 6};
+
+/* faces, edges and corners weighted 4:2:1, as in the 2D stencil */
+static const ELEMENT_TYPE stencil_27_coefs[3 * 3 * 3] =
+    {
+        1.0 / 56, 2.0 / 56, 1.0 / 56,
+        2.0 / 56, 4.0 / 56, 2.0 / 56,
+        1.0 / 56, 2.0 / 56, 1.0 / 56,
+
+        2.0 / 56, 4.0 / 56, 2.0 / 56,
+        4.0 / 56, -1.00,    4.0 / 56,
+        2.0 / 56, 4.0 / 56, 2.0 / 56,
+
+        1.0 / 56, 2.0 / 56, 1.0 / 56,
+        2.0 / 56, 4.0 / 56, 2.0 / 56,
+        1.0 / 56, 2.0 / 56, 1.0 / 56};
+
 enum e_initial_mesh_type
 {
         initial_mesh_zero = 1,
-        initial_mesh_random = 2
+        initial_mesh_random = 2,
+        /* ensemble only: zero and random meshes in turn */
+        initial_mesh_mixed = 3
+};
+
+enum e_stencil_engine
+{
+        stencil_engine_naive = 0,
+        stencil_engine_active,
+        /* 3D only: planes shared between threads */
+        stencil_engine_omp,
+        /* 3D only: x/y tiles shared between threads, each streamed along z */
+        stencil_engine_blocked
+};
+
+static const char *stencil_engine_names[] = {"naive", "active", "omp", "blocked"};
+
+enum e_stencil_scheme
+{
+        /* every cell from the previous sweep's values, through a temporary mesh */
+        stencil_scheme_jacobi = 0,
+        /* in place, cells of one color at a time reading the latest values of the others */
+        stencil_scheme_redblack,
+        /* multigrid cycles smoothed by redblack sweeps, visiting coarse levels once or twice per level */
+        stencil_scheme_vcycle,
+        stencil_scheme_wcycle
+};
+
+static const char *stencil_scheme_names[] = {"jacobi", "redblack", "vcycle", "wcycle"};
+
+enum e_coef_layout
+{
+        /* stencil_coefs everywhere */
+        coef_layout_constant = 0,
+        /* one mesh-sized plane of coefficients per tap */
+        coef_layout_planes,
+        /* a coefficient set per region, and each row as runs of cells of one region */
+        coef_layout_regions
+};
+
+static const char *coef_layout_names[] = {"constant", "planes", "regions"};
+
+enum e_side
+{
+        side_top = 0,
+        side_bottom,
+        side_left,
+        side_right,
+        nb_sides
+};
+
+static const char *side_names[] = {"top", "bottom", "left", "right"};
+
+enum e_boundary
+{
+        /* the halo keeps the *_BOUNDARY_VALUE it was initialized with */
+        boundary_dirichlet = 0,
+        /* the halo holds the interior cells of the opposite side */
+        boundary_periodic,
+        /* the halo mirrors the nearest interior cells: no flux across the side */
+        boundary_neumann
+};
+
+static const char *boundary_names[] = {"dirichlet", "periodic", "neumann"};
+
+/* cells of one color are 2 apart in x or y, out of each other's 3x3 neighbourhood */
+#define NB_COLORS 4
+
+/* smoothing sweeps before and after the coarse correction */
+#define MULTIGRID_PRE_SWEEPS 2
+#define MULTIGRID_POST_SWEEPS 2
+
+/* levels stop coarsening below this width or height; the coarsest one is only smoothed */
+#define MULTIGRID_MIN_SIZE 5
+#define MULTIGRID_COARSEST_SWEEPS 32
+
+/*
+ * How a run ended: fine-mesh sweeps done, and the largest change of a cell
+ * in the last one, or for multigrid the cycles done and the largest
+ * residual of the fine mesh after the last one.
+ */
+struct s_convergence
+{
+        int nb_sweeps;
+        int nb_cycles;
+        ELEMENT_TYPE residual;
 };
 
 struct s_settings
 {
+        enum e_stencil_engine engine;
+        enum e_stencil_scheme scheme;
+        enum e_coef_layout coef_layout;
+        enum e_boundary boundaries[nb_sides];
         int mesh_width;
         int mesh_height;
+        /* 1 for a 2D mesh; a 3D mesh has the 7- or 27-point stencil of nb_points */
+        int mesh_depth;
+        int nb_points;
+        int tile_width;
+        int tile_height;
         enum e_initial_mesh_type initial_mesh_type;
         int nb_iterations;
+        /* stop once a sweep changes no cell by more than this, 0 to always run nb_iterations */
+        double tolerance;
+        int ensemble_size;
         int nb_repeat;
+        int nb_warmup;
+        double min_time;
+        int enable_pinning;
+        int enable_summary;
+        int enable_perf_counters;
+        int enable_phase_timing;
+        int enable_bandwidth_report;
         int enable_output;
         int enable_verbose;
 };
@@ -71,9 +240,27 @@ static void usage(void)
         fprintf(stderr, "usage: stencil [OPTIONS...]\n");
         fprintf(stderr, "    --mesh-width  MESH_WIDTH\n");
         fprintf(stderr, "    --mesh-height MESH_HEIGHT\n");
-        fprintf(stderr, "    --initial-mesh <zero|random>\n");
+        fprintf(stderr, "    --mesh-depth  MESH_DEPTH\n");
+        fprintf(stderr, "    --points <7|27>\n");
+        fprintf(stderr, "    --engine <naive|active|omp|blocked>\n");
+        fprintf(stderr, "    --tile-width  TILE_WIDTH\n");
+        fprintf(stderr, "    --tile-height TILE_HEIGHT\n");
+        fprintf(stderr, "    --scheme <jacobi|redblack|vcycle|wcycle>\n");
+        fprintf(stderr, "    --coefs <constant|planes|regions>\n");
+        fprintf(stderr, "    --boundary <dirichlet|periodic|neumann>\n");
+        fprintf(stderr, "    --boundary-<top|bottom|left|right> <dirichlet|periodic|neumann>\n");
+        fprintf(stderr, "    --initial-mesh <zero|random|mixed>\n");
         fprintf(stderr, "    --nb-iterations NB_ITERATIONS\n");
+        fprintf(stderr, "    --tolerance TOLERANCE\n");
+        fprintf(stderr, "    --ensemble NB_MESHES\n");
         fprintf(stderr, "    --nb-repeat NB_REPEAT\n");
+        fprintf(stderr, "    --warmup NB_WARMUP\n");
+        fprintf(stderr, "    --min-time MIN_TIME\n");
+        fprintf(stderr, "    --no-pin\n");
+        fprintf(stderr, "    --summary\n");
+        fprintf(stderr, "    --perf-counters\n");
+        fprintf(stderr, "    --phase-timing\n");
+        fprintf(stderr, "    --bandwidth-report\n");
         fprintf(stderr, "    --output\n");
         fprintf(stderr, "    --verbose\n");
         fprintf(stderr, "\n");
@@ -88,16 +275,71 @@ static void init_settings(struct s_settings **pp_settings)
         {
                 PRINT_ERROR("memory allocation failed");
         }
-        p_settings->mesh_width = DEFAULT_MESH_WIDTH;
-        p_settings->mesh_height = DEFAULT_MESH_HEIGHT;
+        p_settings->engine = stencil_engine_naive;
+        p_settings->scheme = stencil_scheme_jacobi;
+        p_settings->coef_layout = coef_layout_constant;
+        /* 0 until parsed: the 2D and 3D defaults differ */
+        p_settings->mesh_width = 0;
+        p_settings->mesh_height = 0;
+        p_settings->mesh_depth = 0;
+        p_settings->nb_points = 0;
+        p_settings->tile_width = DEFAULT_TILE_WIDTH;
+        p_settings->tile_height = 0;
         p_settings->initial_mesh_type = initial_mesh_zero;
-        p_settings->nb_iterations = DEFAULT_NB_ITERATIONS;
+        p_settings->nb_iterations = 0;
+        p_settings->tolerance = 0.0;
+        p_settings->ensemble_size = DEFAULT_ENSEMBLE_SIZE;
         p_settings->nb_repeat = DEFAULT_NB_REPEAT;
+        p_settings->nb_warmup = DEFAULT_NB_WARMUP;
+        p_settings->min_time = DEFAULT_MIN_TIME;
+        p_settings->enable_pinning = 1;
+        p_settings->enable_summary = 0;
+        p_settings->enable_perf_counters = 0;
+        p_settings->enable_phase_timing = 0;
+        p_settings->enable_bandwidth_report = 0;
         p_settings->enable_verbose = 0;
         p_settings->enable_output = 0;
         *pp_settings = p_settings;
 }
 
+static enum e_boundary parse_boundary(const char *name)
+{
+        enum e_boundary boundary;
+        for (boundary = boundary_dirichlet; boundary <= boundary_neumann; boundary++)
+        {
+                if (strcmp(name, boundary_names[boundary]) == 0)
+                {
+                        return boundary;
+                }
+        }
+        fprintf(stderr, "invalid boundary '%s'\n", name);
+        exit(EXIT_FAILURE);
+}
+
+/* dirichlet halos never change, so all-dirichlet meshes need no halo refresh */
+static int all_boundaries_dirichlet(struct s_settings *p_settings)
+{
+        int side;
+        for (side = 0; side < nb_sides; side++)
+        {
+                if (p_settings->boundaries[side] != boundary_dirichlet)
+                {
+                        return 0;
+                }
+        }
+        return 1;
+}
+
+static int is_multigrid(struct s_settings *p_settings)
+{
+        return p_settings->scheme == stencil_scheme_vcycle || p_settings->scheme == stencil_scheme_wcycle;
+}
+
+static int is_3d(struct s_settings *p_settings)
+{
+        return p_settings->mesh_depth > 1;
+}
+
 static void parse_cmd_line(int argc, char *argv[], struct s_settings *p_settings)
 {
         int i = 1;
@@ -133,6 +375,191 @@ static void parse_cmd_line(int argc, char *argv[], struct s_settings *p_settings
                         }
                         p_settings->mesh_height = value;
                 }
+                else if (strcmp(argv[i], "--mesh-depth") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        int value = atoi(argv[i]);
+                        if (value < 2 * STENCIL_RADIUS + 1)
+                        {
+                                fprintf(stderr, "invalid MESH_DEPTH argument\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        p_settings->mesh_depth = value;
+                }
+                else if (strcmp(argv[i], "--points") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        if (strcmp(argv[i], "7") == 0)
+                        {
+                                p_settings->nb_points = 7;
+                        }
+                        else if (strcmp(argv[i], "27") == 0)
+                        {
+                                p_settings->nb_points = 27;
+                        }
+                        else
+                        {
+                                fprintf(stderr, "invalid number of points '%s'\n", argv[i]);
+                                exit(EXIT_FAILURE);
+                        }
+                }
+                else if (strcmp(argv[i], "--tile-width") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        int value = atoi(argv[i]);
+                        if (value < 1)
+                        {
+                                fprintf(stderr, "invalid TILE_WIDTH argument\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        p_settings->tile_width = value;
+                }
+                else if (strcmp(argv[i], "--tile-height") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        int value = atoi(argv[i]);
+                        if (value < 1)
+                        {
+                                fprintf(stderr, "invalid TILE_HEIGHT argument\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        p_settings->tile_height = value;
+                }
+                else if (strcmp(argv[i], "--engine") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        if (strcmp(argv[i], "naive") == 0)
+                        {
+                                p_settings->engine = stencil_engine_naive;
+                        }
+                        else if (strcmp(argv[i], "active") == 0)
+                        {
+                                p_settings->engine = stencil_engine_active;
+                        }
+                        else if (strcmp(argv[i], "omp") == 0)
+                        {
+                                p_settings->engine = stencil_engine_omp;
+                        }
+                        else if (strcmp(argv[i], "blocked") == 0)
+                        {
+                                p_settings->engine = stencil_engine_blocked;
+                        }
+                        else
+                        {
+                                fprintf(stderr, "invalid engine '%s'\n", argv[i]);
+                                exit(EXIT_FAILURE);
+                        }
+                }
+                else if (strcmp(argv[i], "--scheme") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        if (strcmp(argv[i], "jacobi") == 0)
+                        {
+                                p_settings->scheme = stencil_scheme_jacobi;
+                        }
+                        else if (strcmp(argv[i], "redblack") == 0)
+                        {
+                                p_settings->scheme = stencil_scheme_redblack;
+                        }
+                        else if (strcmp(argv[i], "vcycle") == 0)
+                        {
+                                p_settings->scheme = stencil_scheme_vcycle;
+                        }
+                        else if (strcmp(argv[i], "wcycle") == 0)
+                        {
+                                p_settings->scheme = stencil_scheme_wcycle;
+                        }
+                        else
+                        {
+                                fprintf(stderr, "invalid scheme '%s'\n", argv[i]);
+                                exit(EXIT_FAILURE);
+                        }
+                }
+                else if (strcmp(argv[i], "--coefs") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        if (strcmp(argv[i], "constant") == 0)
+                        {
+                                p_settings->coef_layout = coef_layout_constant;
+                        }
+                        else if (strcmp(argv[i], "planes") == 0)
+                        {
+                                p_settings->coef_layout = coef_layout_planes;
+                        }
+                        else if (strcmp(argv[i], "regions") == 0)
+                        {
+                                p_settings->coef_layout = coef_layout_regions;
+                        }
+                        else
+                        {
+                                fprintf(stderr, "invalid coefficient layout '%s'\n", argv[i]);
+                                exit(EXIT_FAILURE);
+                        }
+                }
+                else if (strcmp(argv[i], "--boundary") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        const enum e_boundary boundary = parse_boundary(argv[i]);
+                        int side;
+                        for (side = 0; side < nb_sides; side++)
+                        {
+                                p_settings->boundaries[side] = boundary;
+                        }
+                }
+                else if (strncmp(argv[i], "--boundary-", strlen("--boundary-")) == 0)
+                {
+                        const char *side_name = argv[i] + strlen("--boundary-");
+                        int side;
+                        for (side = 0; side < nb_sides; side++)
+                        {
+                                if (strcmp(side_name, side_names[side]) == 0)
+                                {
+                                        break;
+                                }
+                        }
+                        if (side == nb_sides)
+                        {
+                                usage();
+                        }
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        p_settings->boundaries[side] = parse_boundary(argv[i]);
+                }
                 else if (strcmp(argv[i], "--initial-mesh") == 0)
                 {
                         i++;
@@ -148,6 +575,10 @@ static void parse_cmd_line(int argc, char *argv[], struct s_settings *p_settings
                         {
                                 p_settings->initial_mesh_type = initial_mesh_random;
                         }
+                        else if (strcmp(argv[i], "mixed") == 0)
+                        {
+                                p_settings->initial_mesh_type = initial_mesh_mixed;
+                        }
                         else
                         {
                                 fprintf(stderr, "invalid initial mesh type\n");
@@ -169,6 +600,36 @@ static void parse_cmd_line(int argc, char *argv[], struct s_settings *p_settings
                         }
                         p_settings->nb_iterations = value;
                 }
+                else if (strcmp(argv[i], "--tolerance") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        double value = atof(argv[i]);
+                        if (!(value > 0.0))
+                        {
+                                fprintf(stderr, "invalid TOLERANCE argument\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        p_settings->tolerance = value;
+                }
+                else if (strcmp(argv[i], "--ensemble") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        int value = atoi(argv[i]);
+                        if (value < 1)
+                        {
+                                fprintf(stderr, "invalid NB_MESHES argument\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        p_settings->ensemble_size = value;
+                }
                 else if (strcmp(argv[i], "--nb-repeat") == 0)
                 {
                         i++;
@@ -184,6 +645,56 @@ static void parse_cmd_line(int argc, char *argv[], struct s_settings *p_settings
                         }
                         p_settings->nb_repeat = value;
                 }
+                else if (strcmp(argv[i], "--warmup") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        int value = atoi(argv[i]);
+                        if (value < 0)
+                        {
+                                fprintf(stderr, "invalid NB_WARMUP argument\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        p_settings->nb_warmup = value;
+                }
+                else if (strcmp(argv[i], "--min-time") == 0)
+                {
+                        i++;
+                        if (i >= argc)
+                        {
+                                usage();
+                        }
+                        double value = atof(argv[i]);
+                        if (!(value >= 0.0))
+                        {
+                                fprintf(stderr, "invalid MIN_TIME argument\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        p_settings->min_time = value;
+                }
+                else if (strcmp(argv[i], "--no-pin") == 0)
+                {
+                        p_settings->enable_pinning = 0;
+                }
+                else if (strcmp(argv[i], "--summary") == 0)
+                {
+                        p_settings->enable_summary = 1;
+                }
+                else if (strcmp(argv[i], "--perf-counters") == 0)
+                {
+                        p_settings->enable_perf_counters = 1;
+                }
+                else if (strcmp(argv[i], "--phase-timing") == 0)
+                {
+                        p_settings->enable_phase_timing = 1;
+                }
+                else if (strcmp(argv[i], "--bandwidth-report") == 0)
+                {
+                        p_settings->enable_bandwidth_report = 1;
+                }
                 else if (strcmp(argv[i], "--output") == 0)
                 {
                         p_settings->enable_output = 1;
@@ -200,27 +711,156 @@ static void parse_cmd_line(int argc, char *argv[], struct s_settings *p_settings
                 i++;
         }
 
-        if (p_settings->enable_output)
+        /* --points alone asks for a 3D mesh of the default depth */
+        if (p_settings->mesh_depth == 0)
         {
-                p_settings->nb_repeat = 1;
-                if (p_settings->nb_iterations > 100)
-                {
-                        p_settings->nb_iterations = 100;
-                }
+                p_settings->mesh_depth = (p_settings->nb_points != 0) ? DEFAULT_MESH_DEPTH : 1;
         }
-}
-
-static void delete_settings(struct s_settings **pp_settings)
-{
-        assert(*pp_settings != NULL);
+        if (p_settings->mesh_width == 0)
+        {
+                p_settings->mesh_width = is_3d(p_settings) ? DEFAULT_MESH_WIDTH_3D : DEFAULT_MESH_WIDTH;
+        }
+        if (p_settings->mesh_height == 0)
+        {
+                p_settings->mesh_height = is_3d(p_settings) ? DEFAULT_MESH_HEIGHT_3D : DEFAULT_MESH_HEIGHT;
+        }
+        if (p_settings->nb_iterations == 0)
+        {
+                p_settings->nb_iterations = is_3d(p_settings) ? DEFAULT_NB_ITERATIONS_3D : DEFAULT_NB_ITERATIONS;
+        }
+
+        /* 3D meshes have their own Jacobi sweeps, with fixed boundaries */
+        if (is_3d(p_settings))
+        {
+                if (p_settings->engine == stencil_engine_active)
+                {
+                        fprintf(stderr, "--engine active only supports 2D meshes\n");
+                        exit(EXIT_FAILURE);
+                }
+                if (p_settings->scheme != stencil_scheme_jacobi || p_settings->coef_layout != coef_layout_constant ||
+                    !all_boundaries_dirichlet(p_settings) || p_settings->tolerance > 0.0 || p_settings->ensemble_size > 1 ||
+                    p_settings->enable_output || p_settings->enable_verbose)
+                {
+                        fprintf(stderr, "--mesh-depth only supports --scheme jacobi, constant coefficients, dirichlet boundaries and a single "
+                                        "mesh, without --tolerance, --output or --verbose\n");
+                        exit(EXIT_FAILURE);
+                }
+                if (p_settings->nb_points == 0)
+                {
+                        p_settings->nb_points = 7;
+                }
+                if (p_settings->tile_width == 0)
+                {
+                        p_settings->tile_width = p_settings->mesh_width - 2 * STENCIL_RADIUS;
+                }
+                if (p_settings->tile_height == 0)
+                {
+                        p_settings->tile_height = DEFAULT_TILE_HEIGHT;
+                }
+        }
+        else if (p_settings->engine == stencil_engine_omp || p_settings->engine == stencil_engine_blocked)
+        {
+                fprintf(stderr, "--engine omp and blocked only support 3D meshes\n");
+                exit(EXIT_FAILURE);
+        }
+        else if (p_settings->tile_width != 0 || p_settings->tile_height != 0)
+        {
+                fprintf(stderr, "--tile-width and --tile-height only apply to 3D meshes\n");
+                exit(EXIT_FAILURE);
+        }
+
+        /* output and verbose mode follow the iterations of a single mesh */
+        if (p_settings->ensemble_size > 1 && (p_settings->enable_output || p_settings->enable_verbose))
+        {
+                fprintf(stderr, "--output and --verbose cannot be combined with --ensemble\n");
+                exit(EXIT_FAILURE);
+        }
+
+        /* the active engine tracks changes between Jacobi sweeps */
+        if (p_settings->engine == stencil_engine_active && p_settings->scheme != stencil_scheme_jacobi)
+        {
+                fprintf(stderr, "--engine active only supports --scheme jacobi\n");
+                exit(EXIT_FAILURE);
+        }
+
+        /* meshes of an ensemble would each stop after a different number of sweeps */
+        if (p_settings->ensemble_size > 1 && p_settings->tolerance > 0.0)
+        {
+                fprintf(stderr, "--tolerance cannot be combined with --ensemble\n");
+                exit(EXIT_FAILURE);
+        }
+
+        if (p_settings->ensemble_size > 1 && is_multigrid(p_settings))
+        {
+                fprintf(stderr, "--scheme vcycle and wcycle cannot be combined with --ensemble\n");
+                exit(EXIT_FAILURE);
+        }
+
+        /* a periodic side wraps onto the opposite one */
+        if ((p_settings->boundaries[side_top] == boundary_periodic) != (p_settings->boundaries[side_bottom] == boundary_periodic) ||
+            (p_settings->boundaries[side_left] == boundary_periodic) != (p_settings->boundaries[side_right] == boundary_periodic))
+        {
+                fprintf(stderr, "periodic boundaries must be set on opposite sides together\n");
+                exit(EXIT_FAILURE);
+        }
+
+        /* the active engine only tracks changes inside the mesh, and coarse multigrid levels assume fixed boundaries */
+        if (!all_boundaries_dirichlet(p_settings) && (p_settings->engine == stencil_engine_active || is_multigrid(p_settings)))
+        {
+                fprintf(stderr, "periodic and neumann boundaries are not supported by --engine active, --scheme vcycle and wcycle\n");
+                exit(EXIT_FAILURE);
+        }
+
+        /* variable coefficients have their own Jacobi sweeps */
+        if (p_settings->coef_layout != coef_layout_constant &&
+            (p_settings->engine != stencil_engine_naive || p_settings->scheme != stencil_scheme_jacobi || p_settings->ensemble_size > 1))
+        {
+                fprintf(stderr, "--coefs planes and regions only support --engine naive, --scheme jacobi and a single mesh\n");
+                exit(EXIT_FAILURE);
+        }
+
+        /* the nominal traffic and the single-threaded peak copy only model one mesh swept whole by one thread */
+        if (p_settings->enable_bandwidth_report &&
+            (p_settings->engine != stencil_engine_naive || p_settings->scheme != stencil_scheme_jacobi || p_settings->ensemble_size > 1))
+        {
+                fprintf(stderr, "--bandwidth-report only supports --engine naive, --scheme jacobi and a single mesh\n");
+                exit(EXIT_FAILURE);
+        }
+
+        if (p_settings->enable_output)
+        {
+                p_settings->nb_repeat = 1;
+                p_settings->nb_warmup = 0;
+                p_settings->min_time = 0.0;
+                if (p_settings->nb_iterations > 100)
+                {
+                        p_settings->nb_iterations = 100;
+                }
+        }
+}
+
+static void delete_settings(struct s_settings **pp_settings)
+{
+        assert(*pp_settings != NULL);
         free(*pp_settings);
         pp_settings = NULL;
 }
 
-static void allocate_mesh(ELEMENT_TYPE **pp_mesh, struct s_settings *p_settings)
+static size_t mesh_size(struct s_settings *p_settings)
+{
+        return (size_t)p_settings->mesh_width * p_settings->mesh_height * p_settings->mesh_depth;
+}
+
+static inline size_t cell_index(int x, int y, int z, struct s_settings *p_settings)
+{
+        return ((size_t)z * p_settings->mesh_height + y) * p_settings->mesh_width + x;
+}
+
+/* nb_meshes meshes one after the other in a single arena */
+static void allocate_mesh(ELEMENT_TYPE **pp_mesh, int nb_meshes, struct s_settings *p_settings)
 {
         assert(*pp_mesh == NULL);
-        ELEMENT_TYPE *p_mesh = calloc(p_settings->mesh_width * p_settings->mesh_height, sizeof(*p_mesh));
+        ELEMENT_TYPE *p_mesh = calloc(nb_meshes * mesh_size(p_settings), sizeof(*p_mesh));
         if (p_mesh == NULL)
         {
                 PRINT_ERROR("memory allocation failed");
@@ -235,17 +875,27 @@ static void delete_mesh(ELEMENT_TYPE **pp_mesh)
         pp_mesh = NULL;
 }
 
+/* the single plane of a 2D mesh has no front or back halo */
+static int margin_z(struct s_settings *p_settings)
+{
+        return is_3d(p_settings) ? STENCIL_RADIUS : 0;
+}
+
 static void init_mesh_zero(ELEMENT_TYPE *p_mesh, struct s_settings *p_settings)
 {
         const int margin_x = (STENCIL_WIDTH - 1) / 2;
         const int margin_y = (STENCIL_HEIGHT - 1) / 2;
         int x;
         int y;
-        for (y = margin_y; y < p_settings->mesh_height - margin_y; y++)
+        int z;
+        for (z = margin_z(p_settings); z < p_settings->mesh_depth - margin_z(p_settings); z++)
         {
-                for (x = margin_x; x < p_settings->mesh_width - margin_x; x++)
+                for (y = margin_y; y < p_settings->mesh_height - margin_y; y++)
                 {
-                        p_mesh[y * p_settings->mesh_width + x] = 0;
+                        for (x = margin_x; x < p_settings->mesh_width - margin_x; x++)
+                        {
+                                p_mesh[cell_index(x, y, z, p_settings)] = 0;
+                        }
                 }
         }
 }
@@ -256,18 +906,28 @@ static void init_mesh_random(ELEMENT_TYPE *p_mesh, struct s_settings *p_settings
         const int margin_y = (STENCIL_HEIGHT - 1) / 2;
         int x;
         int y;
-        for (y = margin_y; y < p_settings->mesh_height - margin_y; y++)
+        int z;
+        for (z = margin_z(p_settings); z < p_settings->mesh_depth - margin_z(p_settings); z++)
         {
-                for (x = margin_x; x < p_settings->mesh_width - margin_x; x++)
+                for (y = margin_y; y < p_settings->mesh_height - margin_y; y++)
                 {
-                        ELEMENT_TYPE value = rand() / (ELEMENT_TYPE)RAND_MAX * 20 - 10;
-                        p_mesh[y * p_settings->mesh_width + x] = value;
+                        for (x = margin_x; x < p_settings->mesh_width - margin_x; x++)
+                        {
+                                ELEMENT_TYPE value = rand() / (ELEMENT_TYPE)RAND_MAX * 20 - 10;
+                                p_mesh[cell_index(x, y, z, p_settings)] = value;
+                        }
                 }
         }
 }
-static void init_mesh_values(ELEMENT_TYPE *p_mesh, struct s_settings *p_settings)
+static void init_mesh_values(ELEMENT_TYPE *p_mesh, int mesh_index, struct s_settings *p_settings)
 {
-        switch (p_settings->initial_mesh_type)
+        enum e_initial_mesh_type initial_mesh_type = p_settings->initial_mesh_type;
+        if (initial_mesh_type == initial_mesh_mixed)
+        {
+                initial_mesh_type = (mesh_index % 2 == 0) ? initial_mesh_zero : initial_mesh_random;
+        }
+
+        switch (initial_mesh_type)
         {
         case initial_mesh_zero:
                 init_mesh_zero(p_mesh, p_settings);
@@ -284,43 +944,172 @@ static void init_mesh_values(ELEMENT_TYPE *p_mesh, struct s_settings *p_settings
 
 static void copy_mesh(ELEMENT_TYPE *p_dst_mesh, const ELEMENT_TYPE *p_src_mesh, struct s_settings *p_settings)
 {
-        memcpy(p_dst_mesh, p_src_mesh, p_settings->mesh_width * p_settings->mesh_height * sizeof(*p_dst_mesh));
+        memcpy(p_dst_mesh, p_src_mesh, mesh_size(p_settings) * sizeof(*p_dst_mesh));
 }
 
+/* in 3D, front and back planes first, then the top and bottom rows and left and right columns of each plane, as in 2D */
 static void apply_boundary_conditions(ELEMENT_TYPE *p_mesh, struct s_settings *p_settings)
 {
         const int margin_x = (STENCIL_WIDTH - 1) / 2;
         const int margin_y = (STENCIL_HEIGHT - 1) / 2;
         int x;
         int y;
+        int z;
 
-        for (x = 0; x < p_settings->mesh_width; x++)
+        for (y = 0; y < p_settings->mesh_height; y++)
         {
-                for (y = 0; y < margin_y; y++)
+                for (x = 0; x < p_settings->mesh_width; x++)
                 {
-                        p_mesh[y * p_settings->mesh_width + x] = TOP_BOUNDARY_VALUE;
-                        p_mesh[(p_settings->mesh_height - 1 - y) * p_settings->mesh_width + x] = BOTTOM_BOUNDARY_VALUE;
+                        for (z = 0; z < margin_z(p_settings); z++)
+                        {
+                                p_mesh[cell_index(x, y, z, p_settings)] = FRONT_BOUNDARY_VALUE;
+                                p_mesh[cell_index(x, y, p_settings->mesh_depth - 1 - z, p_settings)] = BACK_BOUNDARY_VALUE;
+                        }
                 }
         }
 
-        for (y = margin_y; y < p_settings->mesh_height - margin_y; y++)
+        for (z = margin_z(p_settings); z < p_settings->mesh_depth - margin_z(p_settings); z++)
+        {
+                for (x = 0; x < p_settings->mesh_width; x++)
+                {
+                        for (y = 0; y < margin_y; y++)
+                        {
+                                p_mesh[cell_index(x, y, z, p_settings)] = TOP_BOUNDARY_VALUE;
+                                p_mesh[cell_index(x, p_settings->mesh_height - 1 - y, z, p_settings)] = BOTTOM_BOUNDARY_VALUE;
+                        }
+                }
+
+                for (y = margin_y; y < p_settings->mesh_height - margin_y; y++)
+                {
+                        for (x = 0; x < margin_x; x++)
+                        {
+                                p_mesh[cell_index(x, y, z, p_settings)] = LEFT_BOUNDARY_VALUE;
+                                p_mesh[cell_index(p_settings->mesh_width - 1 - x, y, z, p_settings)] = RIGHT_BOUNDARY_VALUE;
+                        }
+                }
+        }
+}
+
+/*
+ * The boundary cells are a halo: the sweeps read them as any neighbour
+ * and never write them, so the interior loops have no boundary branch.
+ * Before a sweep reads the mesh, the periodic and neumann sides copy
+ * interior cells into their halo. This is the peeled boundary loop: one
+ * pass over the perimeter, negligible next to the interior sweep, so it
+ * runs on one thread. Top and bottom rows are refreshed over the whole
+ * width first, then left and right columns over the whole height, which
+ * also fills the corners from the right interior cell.
+ */
+static void refresh_halo(ELEMENT_TYPE *p_mesh, struct s_settings *p_settings)
+{
+        const int margin_x = (STENCIL_WIDTH - 1) / 2;
+        const int margin_y = (STENCIL_HEIGHT - 1) / 2;
+        const int width = p_settings->mesh_width;
+        const int height = p_settings->mesh_height;
+        const enum e_boundary *boundaries = p_settings->boundaries;
+        const size_t row_size = width * sizeof(*p_mesh);
+        int x;
+        int y;
+
+        for (y = 0; y < margin_y; y++)
+        {
+                /* halo row y mirrors interior row 2 * margin_y - 1 - y, or wraps to row height - 2 * margin_y + y */
+                ELEMENT_TYPE *p_top = p_mesh + y * width;
+                ELEMENT_TYPE *p_bottom = p_mesh + (height - 1 - y) * width;
+                if (boundaries[side_top] == boundary_periodic)
+                {
+                        memcpy(p_top, p_mesh + (height - 2 * margin_y + y) * width, row_size);
+                        memcpy(p_bottom, p_mesh + (2 * margin_y - 1 - y) * width, row_size);
+                        continue;
+                }
+                if (boundaries[side_top] == boundary_neumann)
+                {
+                        memcpy(p_top, p_mesh + (2 * margin_y - 1 - y) * width, row_size);
+                }
+                if (boundaries[side_bottom] == boundary_neumann)
+                {
+                        memcpy(p_bottom, p_mesh + (height - 2 * margin_y + y) * width, row_size);
+                }
+        }
+
+        if (boundaries[side_left] == boundary_dirichlet && boundaries[side_right] == boundary_dirichlet)
         {
+                return;
+        }
+        for (y = 0; y < height; y++)
+        {
+                ELEMENT_TYPE *p_row = p_mesh + y * width;
                 for (x = 0; x < margin_x; x++)
                 {
-                        p_mesh[y * p_settings->mesh_width + x] = LEFT_BOUNDARY_VALUE;
-                        p_mesh[y * p_settings->mesh_width + (p_settings->mesh_width - 1 - x)] = RIGHT_BOUNDARY_VALUE;
+                        if (boundaries[side_left] == boundary_periodic)
+                        {
+                                p_row[x] = p_row[width - 2 * margin_x + x];
+                                p_row[width - 1 - x] = p_row[2 * margin_x - 1 - x];
+                                continue;
+                        }
+                        if (boundaries[side_left] == boundary_neumann)
+                        {
+                                p_row[x] = p_row[2 * margin_x - 1 - x];
+                        }
+                        if (boundaries[side_right] == boundary_neumann)
+                        {
+                                p_row[width - 1 - x] = p_row[width - 2 * margin_x + x];
+                        }
                 }
         }
 }
 
-static void print_settings_csv_header(void)
+static void print_settings_csv_header(struct s_settings *p_settings)
 {
-        printf("mesh_width,mesh_height,nb_iterations,nb_repeat");
+        printf("engine,scheme,mesh_width,mesh_height,nb_iterations,nb_repeat");
+        if (is_3d(p_settings))
+        {
+                printf(",mesh_depth,points,tile_width,tile_height");
+        }
+        if (p_settings->coef_layout != coef_layout_constant)
+        {
+                printf(",coefs");
+        }
+        if (!all_boundaries_dirichlet(p_settings))
+        {
+                printf(",boundaries");
+        }
+        if (p_settings->tolerance > 0.0)
+        {
+                printf(",tolerance");
+        }
+        if (p_settings->ensemble_size > 1)
+        {
+                printf(",ensemble_size");
+        }
 }
 
 static void print_settings_csv(struct s_settings *p_settings)
 {
-        printf("%d,%d,%d,%d", p_settings->mesh_width, p_settings->mesh_height, p_settings->nb_iterations, p_settings->nb_repeat);
+        printf("%s,%s,%d,%d,%d,%d", stencil_engine_names[p_settings->engine], stencil_scheme_names[p_settings->scheme], p_settings->mesh_width,
+               p_settings->mesh_height, p_settings->nb_iterations, p_settings->nb_repeat);
+        if (is_3d(p_settings))
+        {
+                printf(",%d,%d,%d,%d", p_settings->mesh_depth, p_settings->nb_points, p_settings->tile_width, p_settings->tile_height);
+        }
+        if (p_settings->coef_layout != coef_layout_constant)
+        {
+                printf(",%s", coef_layout_names[p_settings->coef_layout]);
+        }
+        if (!all_boundaries_dirichlet(p_settings))
+        {
+                /* top/bottom/left/right */
+                printf(",%s/%s/%s/%s", boundary_names[p_settings->boundaries[side_top]], boundary_names[p_settings->boundaries[side_bottom]],
+                       boundary_names[p_settings->boundaries[side_left]], boundary_names[p_settings->boundaries[side_right]]);
+        }
+        if (p_settings->tolerance > 0.0)
+        {
+                printf(",%le", p_settings->tolerance);
+        }
+        if (p_settings->ensemble_size > 1)
+        {
+                printf(",%d", p_settings->ensemble_size);
+        }
 }
 
 static void print_results_csv_header(void)
@@ -333,11 +1122,135 @@ static void print_results_csv(int rep, double timing_in_seconds, int check_statu
         printf("%d,%le,%d", rep, timing_in_seconds, check_status);
 }
 
-static void print_csv_header(void)
+static void print_convergence_csv_header(struct s_settings *p_settings)
+{
+        if (p_settings->tolerance > 0.0 || is_multigrid(p_settings))
+        {
+                printf(",nb_sweeps,residual");
+        }
+        if (is_multigrid(p_settings))
+        {
+                printf(",nb_cycles");
+        }
+}
+
+static void print_convergence_csv(const struct s_convergence *p_convergence, struct s_settings *p_settings)
+{
+        if (p_settings->tolerance > 0.0 || is_multigrid(p_settings))
+        {
+                printf(",%d,%le", p_convergence->nb_sweeps, p_convergence->residual);
+        }
+        if (is_multigrid(p_settings))
+        {
+                printf(",%d", p_convergence->nb_cycles);
+        }
+}
+
+/* nominal memory traffic of one cell update, coefficients included */
+static double bytes_per_cell_update(struct s_settings *p_settings)
+{
+        if (p_settings->coef_layout == coef_layout_planes)
+        {
+                return BYTES_PER_CELL_UPDATE + NB_TAPS * sizeof(ELEMENT_TYPE);
+        }
+        return BYTES_PER_CELL_UPDATE;
+}
+
+static void print_bandwidth_csv_header(struct s_settings *p_settings)
+{
+        if (p_settings->enable_bandwidth_report)
+        {
+                printf(",bytes_per_cell,peak_gb_per_s,bandwidth_fraction");
+        }
+}
+
+/* bandwidth the sweeps reached, relative to the peak measured on the same footprint */
+static void print_bandwidth_csv(double nb_cell_updates, double timing_in_seconds, double peak_bandwidth, struct s_settings *p_settings)
 {
-        print_settings_csv_header();
+        if (p_settings->enable_bandwidth_report)
+        {
+                const double bandwidth = 1.0e-9 * nb_cell_updates * bytes_per_cell_update(p_settings) / timing_in_seconds;
+                printf(",%lf,%le,%lf", bytes_per_cell_update(p_settings), peak_bandwidth, bandwidth / peak_bandwidth);
+        }
+}
+
+static void print_csv_header(struct s_settings *p_settings)
+{
+        print_settings_csv_header(p_settings);
         printf(",");
         print_results_csv_header();
+        print_convergence_csv_header(p_settings);
+        print_bandwidth_csv_header(p_settings);
+        if (p_settings->enable_phase_timing)
+        {
+                printf(",");
+                phase_timer_print_csv_header();
+        }
+        if (p_settings->enable_perf_counters)
+        {
+                printf(",");
+                perf_counters_print_csv_header();
+        }
+        printf("\n");
+}
+
+static void print_summary_csv_header(struct s_settings *p_settings)
+{
+        print_settings_csv_header(p_settings);
+        printf(",");
+        bench_print_stats_csv_header();
+        printf(",cells_per_s,gb_per_s,check_status");
+        print_convergence_csv_header(p_settings);
+        print_bandwidth_csv_header(p_settings);
+        if (p_settings->enable_phase_timing)
+        {
+                printf(",");
+                phase_timer_print_csv_header();
+        }
+        if (p_settings->enable_perf_counters)
+        {
+                printf(",");
+                perf_counters_print_csv_header();
+        }
+        printf("\n");
+}
+
+/* interior cell updates of one mesh, 2D or 3D, over nb_sweeps sweeps */
+static double mesh_cell_updates(int nb_sweeps, struct s_settings *p_settings)
+{
+        const int margin_x = (STENCIL_WIDTH - 1) / 2;
+        const int margin_y = (STENCIL_HEIGHT - 1) / 2;
+        return (double)(p_settings->mesh_width - 2 * margin_x) * (p_settings->mesh_height - 2 * margin_y) *
+               (p_settings->mesh_depth - 2 * margin_z(p_settings)) * nb_sweeps;
+}
+
+static void print_summary_csv(const struct s_bench_samples *p_samples, int check_status, const struct s_convergence *p_convergence,
+                              double peak_bandwidth, const struct s_phase_timer *p_timer, struct s_settings *p_settings)
+{
+        struct s_bench_stats stats;
+        bench_compute_stats(p_samples, &stats);
+
+        const double nb_cell_updates = mesh_cell_updates(p_convergence->nb_sweeps, p_settings) * p_settings->ensemble_size;
+        const double nb_bytes = nb_cell_updates * bytes_per_cell_update(p_settings);
+
+        print_settings_csv(p_settings);
+        printf(",");
+        bench_print_stats_csv(&stats);
+        printf(",");
+        bench_print_throughput_csv(nb_cell_updates, nb_bytes, &stats);
+        printf(",%d", check_status);
+        print_convergence_csv(p_convergence, p_settings);
+        print_bandwidth_csv(nb_cell_updates, stats.median, peak_bandwidth, p_settings);
+        if (p_settings->enable_phase_timing)
+        {
+                printf(",");
+                phase_timer_print_mean_csv(p_timer);
+        }
+        if (p_settings->enable_perf_counters)
+        {
+                printf(",");
+                perf_counters_print_mean_csv(p_timer->p_perf_counters);
+        }
         printf("\n");
 }
 
@@ -394,29 +1307,43 @@ static void write_mesh_to_file(FILE *file, const ELEMENT_TYPE *p_mesh, struct s_
         }
 }
 
-static void naive_stencil_func(ELEMENT_TYPE *p_mesh, struct s_settings *p_settings)
+/* new value of cell (x, y); every engine goes through it so that they agree bit for bit */
+static inline ELEMENT_TYPE stencil_cell(const ELEMENT_TYPE *p_mesh, int x, int y, struct s_settings *p_settings)
+{
+        const int margin_x = (STENCIL_WIDTH - 1) / 2;
+        const int margin_y = (STENCIL_HEIGHT - 1) / 2;
+        ELEMENT_TYPE value = p_mesh[y * p_settings->mesh_width + x];
+        int stencil_x, stencil_y;
+        for (stencil_x = 0; stencil_x < STENCIL_WIDTH; stencil_x++)
+        {
+                for (stencil_y = 0; stencil_y < STENCIL_HEIGHT; stencil_y++)
+                {
+                        value +=
+                            p_mesh[(y + stencil_y - margin_y) * p_settings->mesh_width + (x + stencil_x - margin_x)] * stencil_coefs[stencil_y * STENCIL_WIDTH + stencil_x];
+                }
+        }
+        return value;
+}
+
+/* each sweep returns the largest change of a cell, the residual --tolerance is compared to */
+static ELEMENT_TYPE naive_stencil_func(ELEMENT_TYPE *p_mesh, ELEMENT_TYPE *p_temporary_mesh, struct s_settings *p_settings)
 {
         const int margin_x = (STENCIL_WIDTH - 1) / 2;
         const int margin_y = (STENCIL_HEIGHT - 1) / 2;
+        ELEMENT_TYPE residual = 0;
         int x;
         int y;
 
-        ELEMENT_TYPE *p_temporary_mesh = malloc(p_settings->mesh_width * p_settings->mesh_height * sizeof(*p_mesh));
+        if (!all_boundaries_dirichlet(p_settings))
+        {
+                refresh_halo(p_mesh, p_settings);
+        }
+
         for (x = margin_x; x < p_settings->mesh_width - margin_x; x++)
         {
                 for (y = margin_y; y < p_settings->mesh_height - margin_y; y++)
                 {
-                        ELEMENT_TYPE value = p_mesh[y * p_settings->mesh_width + x];
-                        int stencil_x, stencil_y;
-                        for (stencil_x = 0; stencil_x < STENCIL_WIDTH; stencil_x++)
-                        {
-                                for (stencil_y = 0; stencil_y < STENCIL_HEIGHT; stencil_y++)
-                                {
-                                        value +=
-                                            p_mesh[(y + stencil_y - margin_y) * p_settings->mesh_width + (x + stencil_x - margin_x)] * stencil_coefs[stencil_y * STENCIL_WIDTH + stencil_x];
-                                }
-                        }
-                        p_temporary_mesh[y * p_settings->mesh_width + x] = value;
+                        p_temporary_mesh[y * p_settings->mesh_width + x] = stencil_cell(p_mesh, x, y, p_settings);
                 }
         }
 
@@ -424,27 +1351,1029 @@ static void naive_stencil_func(ELEMENT_TYPE *p_mesh, struct s_settings *p_settin
         {
                 for (y = margin_y; y < p_settings->mesh_height - margin_y; y++)
                 {
+                        residual = fmaxf(residual, fabsf(p_temporary_mesh[y * p_settings->mesh_width + x] - p_mesh[y * p_settings->mesh_width + x]));
                         p_mesh[y * p_settings->mesh_width + x] = p_temporary_mesh[y * p_settings->mesh_width + x];
                 }
         }
+
+        return residual;
 }
 
-static void run(ELEMENT_TYPE *p_mesh, struct s_settings *p_settings)
+/*
+ * A cell's new value only depends on its neighbourhood, so a cell whose
+ * neighbourhood did not change in the previous sweep would get the same
+ * value again. The interior is cut into tiles, and a tile is recomputed
+ * only if it or one of the 8 tiles around it changed in the previous
+ * sweep; other tiles keep their values, which are exactly what the sweep
+ * would have produced. The first sweep computes every tile, since initial
+ * values are not the result of a sweep. Starting from a zero mesh, only
+ * the tiles the boundary values have reached are computed.
+ */
+struct s_active_region
 {
-        int i;
-        for (i = 0; i < p_settings->nb_iterations; i++)
+        int nb_tiles_x;
+        int nb_tiles_y;
+        unsigned char *changed;
+        unsigned char *active;
+};
+
+static void init_active_region(struct s_active_region **pp_region, struct s_settings *p_settings)
+{
+        assert(*pp_region == NULL);
+        const int margin_x = (STENCIL_WIDTH - 1) / 2;
+        const int margin_y = (STENCIL_HEIGHT - 1) / 2;
+        struct s_active_region *p_region = calloc(1, sizeof(*p_region));
+        if (p_region == NULL)
         {
-                naive_stencil_func(p_mesh, p_settings);
+                PRINT_ERROR("memory allocation failed");
+        }
+        p_region->nb_tiles_x = (p_settings->mesh_width - 2 * margin_x + TILE_WIDTH - 1) / TILE_WIDTH;
+        p_region->nb_tiles_y = (p_settings->mesh_height - 2 * margin_y + TILE_HEIGHT - 1) / TILE_HEIGHT;
+        p_region->changed = calloc(p_region->nb_tiles_x * p_region->nb_tiles_y, sizeof(*p_region->changed));
+        p_region->active = calloc(p_region->nb_tiles_x * p_region->nb_tiles_y, sizeof(*p_region->active));
+        if (p_region->changed == NULL || p_region->active == NULL)
+        {
+                PRINT_ERROR("memory allocation failed");
+        }
+        *pp_region = p_region;
+}
 
-                if (p_settings->enable_output)
+static void delete_active_region(struct s_active_region **pp_region)
+{
+        assert(*pp_region != NULL);
+        free((*pp_region)->changed);
+        free((*pp_region)->active);
+        free(*pp_region);
+        *pp_region = NULL;
+}
+
+/* before the first sweep of a mesh: every tile may change */
+static void reset_active_region(struct s_active_region *p_region)
+{
+        memset(p_region->changed, 1, p_region->nb_tiles_x * p_region->nb_tiles_y * sizeof(*p_region->changed));
+}
+
+static ELEMENT_TYPE active_stencil_func(ELEMENT_TYPE *p_mesh, ELEMENT_TYPE *p_temporary_mesh, struct s_active_region *p_region, struct s_settings *p_settings)
+{
+        const int margin_x = (STENCIL_WIDTH - 1) / 2;
+        const int margin_y = (STENCIL_HEIGHT - 1) / 2;
+        const int width = p_settings->mesh_width;
+        const int nb_tiles_x = p_region->nb_tiles_x;
+        const int nb_tiles_y = p_region->nb_tiles_y;
+        ELEMENT_TYPE residual = 0;
+        int tile_x;
+        int tile_y;
+
+        for (tile_y = 0; tile_y < nb_tiles_y; tile_y++)
+        {
+                for (tile_x = 0; tile_x < nb_tiles_x; tile_x++)
                 {
-                        char filename[32];
-                        snprintf(filename, 32, "run_mesh_%03d.csv", i);
-                        FILE *file = fopen(filename, "w");
-                        if (file == NULL)
+                        int active = 0;
+                        int ty;
+                        for (ty = tile_y - 1; ty <= tile_y + 1; ty++)
                         {
-                                perror("fopen");
-                                exit(EXIT_FAILURE);
+                                int tx;
+                                for (tx = tile_x - 1; tx <= tile_x + 1; tx++)
+                                {
+                                        if (tx >= 0 && tx < nb_tiles_x && ty >= 0 && ty < nb_tiles_y)
+                                        {
+                                                active |= p_region->changed[ty * nb_tiles_x + tx];
+                                        }
+                                }
+                        }
+                        p_region->active[tile_y * nb_tiles_x + tile_x] = active;
+                }
+        }
+
+        for (tile_y = 0; tile_y < nb_tiles_y; tile_y++)
+        {
+                const int y_start = margin_y + tile_y * TILE_HEIGHT;
+                const int y_end = (y_start + TILE_HEIGHT < p_settings->mesh_height - margin_y) ? y_start + TILE_HEIGHT : p_settings->mesh_height - margin_y;
+                for (tile_x = 0; tile_x < nb_tiles_x; tile_x++)
+                {
+                        if (!p_region->active[tile_y * nb_tiles_x + tile_x])
+                        {
+                                continue;
+                        }
+                        const int x_start = margin_x + tile_x * TILE_WIDTH;
+                        const int x_end = (x_start + TILE_WIDTH < width - margin_x) ? x_start + TILE_WIDTH : width - margin_x;
+                        int y;
+                        for (y = y_start; y < y_end; y++)
+                        {
+                                int x;
+                                for (x = x_start; x < x_end; x++)
+                                {
+                                        p_temporary_mesh[y * width + x] = stencil_cell(p_mesh, x, y, p_settings);
+                                }
+                        }
+                }
+        }
+
+        /* copied back once every tile is computed, recording which tiles did change */
+        for (tile_y = 0; tile_y < nb_tiles_y; tile_y++)
+        {
+                const int y_start = margin_y + tile_y * TILE_HEIGHT;
+                const int y_end = (y_start + TILE_HEIGHT < p_settings->mesh_height - margin_y) ? y_start + TILE_HEIGHT : p_settings->mesh_height - margin_y;
+                for (tile_x = 0; tile_x < nb_tiles_x; tile_x++)
+                {
+                        int changed = 0;
+                        if (p_region->active[tile_y * nb_tiles_x + tile_x])
+                        {
+                                const int x_start = margin_x + tile_x * TILE_WIDTH;
+                                const int x_end = (x_start + TILE_WIDTH < width - margin_x) ? x_start + TILE_WIDTH : width - margin_x;
+                                int y;
+                                for (y = y_start; y < y_end; y++)
+                                {
+                                        int x;
+                                        for (x = x_start; x < x_end; x++)
+                                        {
+                                                changed |= (p_mesh[y * width + x] != p_temporary_mesh[y * width + x]);
+                                                residual = fmaxf(residual, fabsf(p_temporary_mesh[y * width + x] - p_mesh[y * width + x]));
+                                                p_mesh[y * width + x] = p_temporary_mesh[y * width + x];
+                                        }
+                                }
+                        }
+                        p_region->changed[tile_y * nb_tiles_x + tile_x] = changed;
+                }
+        }
+
+        return residual;
+}
+
+/*
+ * Gauss-Seidel in place: no temporary mesh, and each cell already reads
+ * the new values of the neighbours updated before it, which usually
+ * takes fewer sweeps to converge. The 3x3 stencil reaches diagonal
+ * neighbours, so a red-black checkerboard would leave neighbours of the
+ * same color; four colors by (x, y) parity keep the cells of a color
+ * independent, and each color is updated in parallel. The result does not
+ * depend on the number of threads.
+ *
+ * Multigrid levels smooth u = S(u) + rhs, S being the stencil; the fine
+ * mesh has no right-hand side.
+ */
+static ELEMENT_TYPE redblack_stencil_func(ELEMENT_TYPE *p_mesh, const ELEMENT_TYPE *p_rhs, int parallel, struct s_settings *p_settings)
+{
+        const int margin_x = (STENCIL_WIDTH - 1) / 2;
+        const int margin_y = (STENCIL_HEIGHT - 1) / 2;
+        ELEMENT_TYPE residual = 0;
+        int color;
+
+        for (color = 0; color < NB_COLORS; color++)
+        {
+                const int color_x = color % 2;
+                const int color_y = color / 2;
+                int y;
+                /* each color reads the halo of the latest values */
+                if (!all_boundaries_dirichlet(p_settings))
+                {
+                        refresh_halo(p_mesh, p_settings);
+                }
+#pragma omp parallel for schedule(static) reduction(max : residual) if (parallel)
+                for (y = margin_y + color_y; y < p_settings->mesh_height - margin_y; y += 2)
+                {
+                        int x;
+                        for (x = margin_x + color_x; x < p_settings->mesh_width - margin_x; x += 2)
+                        {
+                                ELEMENT_TYPE value = stencil_cell(p_mesh, x, y, p_settings);
+                                if (p_rhs != NULL)
+                                {
+                                        value += p_rhs[y * p_settings->mesh_width + x];
+                                }
+                                residual = fmaxf(residual, fabsf(value - p_mesh[y * p_settings->mesh_width + x]));
+                                p_mesh[y * p_settings->mesh_width + x] = value;
+                        }
+                }
+        }
+
+        return residual;
+}
+
+/* parallel: whether the redblack sweep splits its rows over threads, 0 when the caller already runs one mesh per thread */
+static ELEMENT_TYPE stencil_sweep(ELEMENT_TYPE *p_mesh, ELEMENT_TYPE *p_temporary_mesh, struct s_active_region *p_region, int parallel,
+                                  struct s_settings *p_settings)
+{
+        if (p_settings->scheme == stencil_scheme_redblack)
+        {
+                return redblack_stencil_func(p_mesh, NULL, parallel, p_settings);
+        }
+        if (p_settings->engine == stencil_engine_active)
+        {
+                return active_stencil_func(p_mesh, p_temporary_mesh, p_region, p_settings);
+        }
+        return naive_stencil_func(p_mesh, p_temporary_mesh, p_settings);
+}
+
+/*
+ * The steady state solves u - S(u) = 0 with the boundary values fixed.
+ * Sweeps only damp the error quickly at the scale of a few cells, so on a
+ * large mesh the smooth part of the error takes a number of sweeps growing
+ * with the square of the mesh size. A multigrid cycle smooths the fine
+ * mesh, then solves for the error on a mesh of half the size, where it is
+ * twice less smooth, recursively down to a few cells, and adds the
+ * interpolated correction back before smoothing again.
+ *
+ * Coarse cell i sits on fine cell 2 * i. The equation of the error keeps
+ * the fine operator, whose implicit 1 / h^2 scale makes the coarse
+ * right-hand side 4 times the restricted residual. Unless the fine size
+ * is 2^k + 1, the last coarse cell cannot land on the fine boundary.
+ */
+struct s_multigrid_level
+{
+        /* dimensions of the level; the other settings are the fine mesh's */
+        struct s_settings settings;
+        /* the fine level's u is the mesh being solved */
+        ELEMENT_TYPE *p_u;
+        ELEMENT_TYPE *p_rhs;
+        ELEMENT_TYPE *p_residual;
+};
+
+struct s_multigrid
+{
+        int nb_levels;
+        struct s_multigrid_level *levels;
+};
+
+/*
+ * Each level puts its far boundary on its own cell nearest to the fine
+ * one. Deriving a level from the previous one instead would shift the
+ * boundary by up to a cell at every level, and the coarsest levels would
+ * then solve on a noticeably larger or smaller mesh.
+ */
+static int multigrid_level_size(int fine_size, int l)
+{
+        return (int)lround((double)(fine_size - 1) / (1 << l)) + 1;
+}
+
+static void init_multigrid(struct s_multigrid **pp_multigrid, struct s_settings *p_settings)
+{
+        assert(*pp_multigrid == NULL);
+        struct s_multigrid *p_multigrid = calloc(1, sizeof(*p_multigrid));
+        if (p_multigrid == NULL)
+        {
+                PRINT_ERROR("memory allocation failed");
+        }
+
+        p_multigrid->nb_levels = 1;
+        while (multigrid_level_size(p_settings->mesh_width, p_multigrid->nb_levels - 1) >= MULTIGRID_MIN_SIZE &&
+               multigrid_level_size(p_settings->mesh_height, p_multigrid->nb_levels - 1) >= MULTIGRID_MIN_SIZE)
+        {
+                p_multigrid->nb_levels++;
+        }
+
+        p_multigrid->levels = calloc(p_multigrid->nb_levels, sizeof(*p_multigrid->levels));
+        if (p_multigrid->levels == NULL)
+        {
+                PRINT_ERROR("memory allocation failed");
+        }
+
+        int l;
+        for (l = 0; l < p_multigrid->nb_levels; l++)
+        {
+                struct s_multigrid_level *p_level = &p_multigrid->levels[l];
+                p_level->settings = *p_settings;
+                if (l > 0)
+                {
+                        p_level->settings.mesh_width = multigrid_level_size(p_settings->mesh_width, l);
+                        p_level->settings.mesh_height = multigrid_level_size(p_settings->mesh_height, l);
+                        allocate_mesh(&p_level->p_u, 1, &p_level->settings);
+                        allocate_mesh(&p_level->p_rhs, 1, &p_level->settings);
+                }
+                if (l < p_multigrid->nb_levels - 1)
+                {
+                        allocate_mesh(&p_level->p_residual, 1, &p_level->settings);
+                }
+        }
+
+        *pp_multigrid = p_multigrid;
+}
+
+static void delete_multigrid(struct s_multigrid **pp_multigrid)
+{
+        assert(*pp_multigrid != NULL);
+        struct s_multigrid *p_multigrid = *pp_multigrid;
+        int l;
+        for (l = 0; l < p_multigrid->nb_levels; l++)
+        {
+                struct s_multigrid_level *p_level = &p_multigrid->levels[l];
+                if (l > 0)
+                {
+                        delete_mesh(&p_level->p_u);
+                        delete_mesh(&p_level->p_rhs);
+                }
+                if (l < p_multigrid->nb_levels - 1)
+                {
+                        delete_mesh(&p_level->p_residual);
+                }
+        }
+        free(p_multigrid->levels);
+        free(p_multigrid);
+        *pp_multigrid = NULL;
+}
+
+/* residual rhs + S(u) - u of the interior, 0 on the boundary; returns its largest magnitude */
+static ELEMENT_TYPE multigrid_residual(struct s_multigrid_level *p_level, ELEMENT_TYPE *p_residual, int parallel)
+{
+        const int margin_x = (STENCIL_WIDTH - 1) / 2;
+        const int margin_y = (STENCIL_HEIGHT - 1) / 2;
+        struct s_settings *p_settings = &p_level->settings;
+        const int width = p_settings->mesh_width;
+        ELEMENT_TYPE norm = 0;
+        int y;
+
+#pragma omp parallel for schedule(static) reduction(max : norm) if (parallel)
+        for (y = margin_y; y < p_settings->mesh_height - margin_y; y++)
+        {
+                int x;
+                for (x = margin_x; x < width - margin_x; x++)
+                {
+                        ELEMENT_TYPE value = stencil_cell(p_level->p_u, x, y, p_settings) - p_level->p_u[y * width + x];
+                        if (p_level->p_rhs != NULL)
+                        {
+                                value += p_level->p_rhs[y * width + x];
+                        }
+                        norm = fmaxf(norm, fabsf(value));
+                        if (p_residual != NULL)
+                        {
+                                p_residual[y * width + x] = value;
+                        }
+                }
+        }
+
+        return norm;
+}
+
+/* full weighting of the fine residual onto the coarse right-hand side, scaled by 4 */
+static void multigrid_restrict(const struct s_multigrid_level *p_fine, struct s_multigrid_level *p_coarse, int parallel)
+{
+        const int fine_width = p_fine->settings.mesh_width;
+        const int coarse_width = p_coarse->settings.mesh_width;
+        const ELEMENT_TYPE *p_residual = p_fine->p_residual;
+        int y;
+
+#pragma omp parallel for schedule(static) if (parallel)
+        for (y = 1; y < p_coarse->settings.mesh_height - 1; y++)
+        {
+                int x;
+                for (x = 1; x < coarse_width - 1; x++)
+                {
+                        const int i = 2 * y * fine_width + 2 * x;
+                        const ELEMENT_TYPE value =
+                            4 * p_residual[i] +
+                            2 * (p_residual[i - 1] + p_residual[i + 1] + p_residual[i - fine_width] + p_residual[i + fine_width]) +
+                            p_residual[i - fine_width - 1] + p_residual[i - fine_width + 1] + p_residual[i + fine_width - 1] + p_residual[i + fine_width + 1];
+                        p_coarse->p_rhs[y * coarse_width + x] = 4 * value / 16;
+                        p_coarse->p_u[y * coarse_width + x] = 0;
+                }
+        }
+}
+
+/* bilinear interpolation of the coarse correction, added to the fine interior */
+static void multigrid_prolongate(const struct s_multigrid_level *p_coarse, struct s_multigrid_level *p_fine, int parallel)
+{
+        const int fine_width = p_fine->settings.mesh_width;
+        const int coarse_width = p_coarse->settings.mesh_width;
+        const ELEMENT_TYPE *p_correction = p_coarse->p_u;
+        int y;
+
+#pragma omp parallel for schedule(static) if (parallel)
+        for (y = 1; y < p_fine->settings.mesh_height - 1; y++)
+        {
+                const int coarse_y = y / 2;
+                const int next_y = coarse_y + (y % 2);
+                int x;
+                for (x = 1; x < fine_width - 1; x++)
+                {
+                        const int coarse_x = x / 2;
+                        const int next_x = coarse_x + (x % 2);
+                        p_fine->p_u[y * fine_width + x] +=
+                            (p_correction[coarse_y * coarse_width + coarse_x] + p_correction[coarse_y * coarse_width + next_x] +
+                             p_correction[next_y * coarse_width + coarse_x] + p_correction[next_y * coarse_width + next_x]) /
+                            4;
+                }
+        }
+}
+
+static void multigrid_cycle(struct s_multigrid *p_multigrid, int l, int parallel)
+{
+        struct s_multigrid_level *p_level = &p_multigrid->levels[l];
+        int i;
+
+        if (l == p_multigrid->nb_levels - 1)
+        {
+                for (i = 0; i < MULTIGRID_COARSEST_SWEEPS; i++)
+                {
+                        redblack_stencil_func(p_level->p_u, p_level->p_rhs, parallel, &p_level->settings);
+                }
+                return;
+        }
+
+        for (i = 0; i < MULTIGRID_PRE_SWEEPS; i++)
+        {
+                redblack_stencil_func(p_level->p_u, p_level->p_rhs, parallel, &p_level->settings);
+        }
+
+        struct s_multigrid_level *p_coarse = &p_multigrid->levels[l + 1];
+        multigrid_residual(p_level, p_level->p_residual, parallel);
+        multigrid_restrict(p_level, p_coarse, parallel);
+        const int nb_visits = (p_level->settings.scheme == stencil_scheme_wcycle) ? 2 : 1;
+        for (i = 0; i < nb_visits; i++)
+        {
+                multigrid_cycle(p_multigrid, l + 1, parallel);
+        }
+        multigrid_prolongate(p_coarse, p_level, parallel);
+
+        for (i = 0; i < MULTIGRID_POST_SWEEPS; i++)
+        {
+                redblack_stencil_func(p_level->p_u, p_level->p_rhs, parallel, &p_level->settings);
+        }
+}
+
+/* one cycle on p_mesh; returns the largest residual of the fine mesh after it */
+static ELEMENT_TYPE multigrid_func(ELEMENT_TYPE *p_mesh, struct s_multigrid *p_multigrid, int parallel)
+{
+        p_multigrid->levels[0].p_u = p_mesh;
+        multigrid_cycle(p_multigrid, 0, parallel);
+        return multigrid_residual(&p_multigrid->levels[0], NULL, parallel);
+}
+
+/*
+ * Heterogeneous media: each region of a REGION_GRID_WIDTH x
+ * REGION_GRID_HEIGHT grid has its own horizontal and vertical weights,
+ * still normalized so that a cell becomes a weighted mean of its
+ * neighbours. The coefficients of a tap are stored either as a plane
+ * aligned with the mesh, so that the sweep reads them with the same
+ * unit stride as the mesh and vectorizes, or compressed as a set per
+ * region with each row cut into runs of cells of the same region, so
+ * that the sweep applies constant coefficients along each run and reads
+ * no coefficient per cell.
+ */
+struct s_variable_coefs
+{
+        /* planes: tap t of cell i at p_planes[t * mesh_size + i] */
+        ELEMENT_TYPE *p_planes;
+        /* regions: runs of row y are run_starts[y] to run_starts[y + 1] - 1 */
+        ELEMENT_TYPE region_coefs[NB_REGIONS][NB_TAPS];
+        int *run_starts;
+        int *run_x;
+        unsigned char *run_regions;
+};
+
+static int region_of_cell(int x, int y, struct s_settings *p_settings)
+{
+        const int region_x = (int)((long long)x * REGION_GRID_WIDTH / p_settings->mesh_width);
+        const int region_y = (int)((long long)y * REGION_GRID_HEIGHT / p_settings->mesh_height);
+        return region_y * REGION_GRID_WIDTH + region_x;
+}
+
+/* horizontal, vertical and diagonal taps scaled by the region's weights, then normalized */
+static void init_region_coefs(ELEMENT_TYPE *p_coefs, int region)
+{
+        const double horizontal = 1 + region % REGION_GRID_WIDTH;
+        const double vertical = 1 + region / REGION_GRID_WIDTH;
+        const int center = NB_TAPS / 2;
+        double weights[NB_TAPS];
+        double sum = 0;
+        int t;
+        for (t = 0; t < NB_TAPS; t++)
+        {
+                const int is_horizontal = (t % STENCIL_WIDTH != STENCIL_WIDTH / 2);
+                const int is_vertical = (t / STENCIL_WIDTH != STENCIL_HEIGHT / 2);
+                double weight = stencil_coefs[t];
+                if (is_horizontal && is_vertical)
+                {
+                        weight *= (horizontal + vertical) / 2;
+                }
+                else if (is_horizontal)
+                {
+                        weight *= horizontal;
+                }
+                else if (is_vertical)
+                {
+                        weight *= vertical;
+                }
+                weights[t] = weight;
+                if (t != center)
+                {
+                        sum += weight;
+                }
+        }
+        for (t = 0; t < NB_TAPS; t++)
+        {
+                p_coefs[t] = (t == center) ? stencil_coefs[t] : weights[t] / sum;
+        }
+}
+
+static void init_variable_coefs(struct s_variable_coefs **pp_coefs, struct s_settings *p_settings)
+{
+        assert(*pp_coefs == NULL);
+        const int margin_x = (STENCIL_WIDTH - 1) / 2;
+        const int margin_y = (STENCIL_HEIGHT - 1) / 2;
+        const int width = p_settings->mesh_width;
+        const size_t size = mesh_size(p_settings);
+        struct s_variable_coefs *p_coefs = calloc(1, sizeof(*p_coefs));
+        if (p_coefs == NULL)
+        {
+                PRINT_ERROR("memory allocation failed");
+        }
+
+        int r;
+        for (r = 0; r < NB_REGIONS; r++)
+        {
+                init_region_coefs(p_coefs->region_coefs[r], r);
+        }
+
+        int x;
+        int y;
+        if (p_settings->coef_layout == coef_layout_planes)
+        {
+                allocate_mesh(&p_coefs->p_planes, NB_TAPS, p_settings);
+                for (y = margin_y; y < p_settings->mesh_height - margin_y; y++)
+                {
+                        for (x = margin_x; x < width - margin_x; x++)
+                        {
+                                const int region = region_of_cell(x, y, p_settings);
+                                int t;
+                                for (t = 0; t < NB_TAPS; t++)
+                                {
+                                        p_coefs->p_planes[t * size + y * width + x] = p_coefs->region_coefs[region][t];
+                                }
+                        }
+                }
+        }
+        else
+        {
+                /* at most one run per interior cell */
+                p_coefs->run_starts = calloc(p_settings->mesh_height + 1, sizeof(*p_coefs->run_starts));
+                p_coefs->run_x = malloc(size * sizeof(*p_coefs->run_x));
+                p_coefs->run_regions = malloc(size * sizeof(*p_coefs->run_regions));
+                if (p_coefs->run_starts == NULL || p_coefs->run_x == NULL || p_coefs->run_regions == NULL)
+                {
+                        PRINT_ERROR("memory allocation failed");
+                }
+                int nb_runs = 0;
+                for (y = 0; y < p_settings->mesh_height; y++)
+                {
+                        p_coefs->run_starts[y] = nb_runs;
+                        if (y < margin_y || y >= p_settings->mesh_height - margin_y)
+                        {
+                                continue;
+                        }
+                        for (x = margin_x; x < width - margin_x; x++)
+                        {
+                                const int region = region_of_cell(x, y, p_settings);
+                                if (x == margin_x || region != p_coefs->run_regions[nb_runs - 1])
+                                {
+                                        p_coefs->run_x[nb_runs] = x;
+                                        p_coefs->run_regions[nb_runs] = region;
+                                        nb_runs++;
+                                }
+                        }
+                }
+                p_coefs->run_starts[p_settings->mesh_height] = nb_runs;
+        }
+
+        *pp_coefs = p_coefs;
+}
+
+static void delete_variable_coefs(struct s_variable_coefs **pp_coefs)
+{
+        assert(*pp_coefs != NULL);
+        struct s_variable_coefs *p_coefs = *pp_coefs;
+        if (p_coefs->p_planes != NULL)
+        {
+                delete_mesh(&p_coefs->p_planes);
+        }
+        free(p_coefs->run_starts);
+        free(p_coefs->run_x);
+        free(p_coefs->run_regions);
+        free(p_coefs);
+        *pp_coefs = NULL;
+}
+
+/* bytes a sweep touches: mesh, temporary mesh and coefficients */
+static size_t variable_coefs_footprint(const struct s_variable_coefs *p_coefs, struct s_settings *p_settings)
+{
+        size_t footprint = 2 * mesh_size(p_settings) * sizeof(ELEMENT_TYPE);
+        if (p_coefs == NULL)
+        {
+                return footprint;
+        }
+        if (p_coefs->p_planes != NULL)
+        {
+                footprint += NB_TAPS * mesh_size(p_settings) * sizeof(ELEMENT_TYPE);
+        }
+        else
+        {
+                footprint += p_coefs->run_starts[p_settings->mesh_height] * (sizeof(*p_coefs->run_x) + sizeof(*p_coefs->run_regions));
+        }
+        return footprint;
+}
+
+/* cells [x_start, x_end) of row y into the temporary mesh, with coefficient t of cell x at p_coefs[t * coef_stride + x] */
+static inline void variable_stencil_row(const ELEMENT_TYPE *restrict p_mesh, ELEMENT_TYPE *restrict p_temporary_mesh,
+                                        const ELEMENT_TYPE *restrict p_coefs, size_t coef_stride, int x_start, int x_end, int y,
+                                        struct s_settings *p_settings)
+{
+        const int margin_x = (STENCIL_WIDTH - 1) / 2;
+        const int margin_y = (STENCIL_HEIGHT - 1) / 2;
+        const int width = p_settings->mesh_width;
+        int x;
+        for (x = x_start; x < x_end; x++)
+        {
+                ELEMENT_TYPE value = p_mesh[y * width + x];
+                int stencil_x, stencil_y;
+                for (stencil_x = 0; stencil_x < STENCIL_WIDTH; stencil_x++)
+                {
+                        for (stencil_y = 0; stencil_y < STENCIL_HEIGHT; stencil_y++)
+                        {
+                                value += p_mesh[(y + stencil_y - margin_y) * width + (x + stencil_x - margin_x)] *
+                                         p_coefs[(stencil_y * STENCIL_WIDTH + stencil_x) * coef_stride + x];
+                        }
+                }
+                p_temporary_mesh[y * width + x] = value;
+        }
+}
+
+/* cells [x_start, x_end) of row y, all in a region with coefficients p_coefs */
+static inline void variable_region_run(const ELEMENT_TYPE *restrict p_mesh, ELEMENT_TYPE *restrict p_temporary_mesh,
+                                       const ELEMENT_TYPE *restrict p_coefs, int x_start, int x_end, int y, struct s_settings *p_settings)
+{
+        const int margin_x = (STENCIL_WIDTH - 1) / 2;
+        const int margin_y = (STENCIL_HEIGHT - 1) / 2;
+        const int width = p_settings->mesh_width;
+        int x;
+        for (x = x_start; x < x_end; x++)
+        {
+                ELEMENT_TYPE value = p_mesh[y * width + x];
+                int stencil_x, stencil_y;
+                for (stencil_x = 0; stencil_x < STENCIL_WIDTH; stencil_x++)
+                {
+                        for (stencil_y = 0; stencil_y < STENCIL_HEIGHT; stencil_y++)
+                        {
+                                value += p_mesh[(y + stencil_y - margin_y) * width + (x + stencil_x - margin_x)] *
+                                         p_coefs[stencil_y * STENCIL_WIDTH + stencil_x];
+                        }
+                }
+                p_temporary_mesh[y * width + x] = value;
+        }
+}
+
+/* copies the interior back and returns the largest change of a cell */
+static ELEMENT_TYPE variable_copy_back(ELEMENT_TYPE *p_mesh, const ELEMENT_TYPE *p_temporary_mesh, struct s_settings *p_settings)
+{
+        const int margin_x = (STENCIL_WIDTH - 1) / 2;
+        const int margin_y = (STENCIL_HEIGHT - 1) / 2;
+        const int width = p_settings->mesh_width;
+        ELEMENT_TYPE residual = 0;
+        int y;
+        for (y = margin_y; y < p_settings->mesh_height - margin_y; y++)
+        {
+                int x;
+                for (x = margin_x; x < width - margin_x; x++)
+                {
+                        residual = fmaxf(residual, fabsf(p_temporary_mesh[y * width + x] - p_mesh[y * width + x]));
+                        p_mesh[y * width + x] = p_temporary_mesh[y * width + x];
+                }
+        }
+        return residual;
+}
+
+/*
+ * Both layouts sweep column tiles row by row: whatever the mesh width,
+ * the three mesh rows a row reads are still in L1 from the previous row,
+ * and the coefficient rows are streamed once.
+ */
+static ELEMENT_TYPE variable_stencil_func(ELEMENT_TYPE *p_mesh, ELEMENT_TYPE *p_temporary_mesh, const struct s_variable_coefs *p_coefs,
+                                          struct s_settings *p_settings)
+{
+        const int margin_x = (STENCIL_WIDTH - 1) / 2;
+        const int margin_y = (STENCIL_HEIGHT - 1) / 2;
+        const int width = p_settings->mesh_width;
+        const size_t size = mesh_size(p_settings);
+        int tile_x;
+
+        if (!all_boundaries_dirichlet(p_settings))
+        {
+                refresh_halo(p_mesh, p_settings);
+        }
+
+        for (tile_x = margin_x; tile_x < width - margin_x; tile_x += VARIABLE_TILE_WIDTH)
+        {
+                const int tile_end = (tile_x + VARIABLE_TILE_WIDTH < width - margin_x) ? tile_x + VARIABLE_TILE_WIDTH : width - margin_x;
+                int y;
+                for (y = margin_y; y < p_settings->mesh_height - margin_y; y++)
+                {
+                        if (p_coefs->p_planes != NULL)
+                        {
+                                variable_stencil_row(p_mesh, p_temporary_mesh, p_coefs->p_planes + y * width, size, tile_x, tile_end, y, p_settings);
+                                continue;
+                        }
+
+                        /* along a run, the coefficients are those of one region */
+                        int run;
+                        for (run = p_coefs->run_starts[y]; run < p_coefs->run_starts[y + 1]; run++)
+                        {
+                                const int run_start = p_coefs->run_x[run];
+                                const int run_end = (run + 1 < p_coefs->run_starts[y + 1]) ? p_coefs->run_x[run + 1] : width - margin_x;
+                                const int x_start = (run_start > tile_x) ? run_start : tile_x;
+                                const int x_end = (run_end < tile_end) ? run_end : tile_end;
+                                if (x_start < x_end)
+                                {
+                                        variable_region_run(p_mesh, p_temporary_mesh, p_coefs->region_coefs[p_coefs->run_regions[run]], x_start, x_end, y,
+                                                            p_settings);
+                                }
+                        }
+                }
+        }
+
+        return variable_copy_back(p_mesh, p_temporary_mesh, p_settings);
+}
+
+/* reference for check: the coefficients of each cell looked up from its region */
+static void variable_reference_func(ELEMENT_TYPE *p_mesh, ELEMENT_TYPE *p_temporary_mesh, const struct s_variable_coefs *p_coefs,
+                                    struct s_settings *p_settings)
+{
+        const int margin_x = (STENCIL_WIDTH - 1) / 2;
+        const int margin_y = (STENCIL_HEIGHT - 1) / 2;
+        int x;
+        int y;
+
+        if (!all_boundaries_dirichlet(p_settings))
+        {
+                refresh_halo(p_mesh, p_settings);
+        }
+
+        for (x = margin_x; x < p_settings->mesh_width - margin_x; x++)
+        {
+                for (y = margin_y; y < p_settings->mesh_height - margin_y; y++)
+                {
+                        const ELEMENT_TYPE *p_cell_coefs = p_coefs->region_coefs[region_of_cell(x, y, p_settings)];
+                        ELEMENT_TYPE value = p_mesh[y * p_settings->mesh_width + x];
+                        int stencil_x, stencil_y;
+                        for (stencil_x = 0; stencil_x < STENCIL_WIDTH; stencil_x++)
+                        {
+                                for (stencil_y = 0; stencil_y < STENCIL_HEIGHT; stencil_y++)
+                                {
+                                        value += p_mesh[(y + stencil_y - margin_y) * p_settings->mesh_width + (x + stencil_x - margin_x)] *
+                                                 p_cell_coefs[stencil_y * STENCIL_WIDTH + stencil_x];
+                                }
+                        }
+                        p_temporary_mesh[y * p_settings->mesh_width + x] = value;
+                }
+        }
+
+        variable_copy_back(p_mesh, p_temporary_mesh, p_settings);
+}
+
+/* new value of cell (x, y, z); every 3D engine goes through these so that they agree bit for bit */
+static inline ELEMENT_TYPE stencil_7_cell(const ELEMENT_TYPE *p_mesh, int x, int y, int z, struct s_settings *p_settings)
+{
+        const size_t i = cell_index(x, y, z, p_settings);
+        const size_t row = p_settings->mesh_width;
+        const size_t plane = row * p_settings->mesh_height;
+        ELEMENT_TYPE value = p_mesh[i];
+        value += p_mesh[i] * stencil_7_coefs[0];
+        value += (p_mesh[i - plane] + p_mesh[i + plane] + p_mesh[i - row] + p_mesh[i + row] + p_mesh[i - 1] + p_mesh[i + 1]) * stencil_7_coefs[1];
+        return value;
+}
+
+static inline ELEMENT_TYPE stencil_27_cell(const ELEMENT_TYPE *p_mesh, int x, int y, int z, struct s_settings *p_settings)
+{
+        ELEMENT_TYPE value = p_mesh[cell_index(x, y, z, p_settings)];
+        int stencil_x, stencil_y, stencil_z;
+        for (stencil_z = 0; stencil_z < 3; stencil_z++)
+        {
+                for (stencil_y = 0; stencil_y < 3; stencil_y++)
+                {
+                        const ELEMENT_TYPE *p_row = p_mesh + cell_index(x - 1, y + stencil_y - 1, z + stencil_z - 1, p_settings);
+                        for (stencil_x = 0; stencil_x < 3; stencil_x++)
+                        {
+                                value += p_row[stencil_x] * stencil_27_coefs[(stencil_z * 3 + stencil_y) * 3 + stencil_x];
+                        }
+                }
+        }
+        return value;
+}
+
+/* rows [y_start, y_end) and columns [x_start, x_end) of plane z, from p_src into p_dst */
+static inline void stencil_3d_block(const ELEMENT_TYPE *p_src, ELEMENT_TYPE *p_dst, int x_start, int x_end, int y_start, int y_end, int z,
+                                    struct s_settings *p_settings)
+{
+        int y;
+        int x;
+        if (p_settings->nb_points == 7)
+        {
+                for (y = y_start; y < y_end; y++)
+                {
+                        for (x = x_start; x < x_end; x++)
+                        {
+                                p_dst[cell_index(x, y, z, p_settings)] = stencil_7_cell(p_src, x, y, z, p_settings);
+                        }
+                }
+        }
+        else
+        {
+                for (y = y_start; y < y_end; y++)
+                {
+                        for (x = x_start; x < x_end; x++)
+                        {
+                                p_dst[cell_index(x, y, z, p_settings)] = stencil_27_cell(p_src, x, y, z, p_settings);
+                        }
+                }
+        }
+}
+
+/* one thread, plane after plane, through the temporary mesh: the 3D reference */
+static void naive_stencil_3d_func(ELEMENT_TYPE *p_mesh, ELEMENT_TYPE *p_temporary_mesh, struct s_settings *p_settings)
+{
+        const int x_end = p_settings->mesh_width - STENCIL_RADIUS;
+        const int y_end = p_settings->mesh_height - STENCIL_RADIUS;
+        int z;
+
+        for (z = STENCIL_RADIUS; z < p_settings->mesh_depth - STENCIL_RADIUS; z++)
+        {
+                stencil_3d_block(p_mesh, p_temporary_mesh, STENCIL_RADIUS, x_end, STENCIL_RADIUS, y_end, z, p_settings);
+        }
+
+        for (z = STENCIL_RADIUS; z < p_settings->mesh_depth - STENCIL_RADIUS; z++)
+        {
+                int y;
+                for (y = STENCIL_RADIUS; y < y_end; y++)
+                {
+                        const size_t i = cell_index(STENCIL_RADIUS, y, z, p_settings);
+                        memcpy(p_mesh + i, p_temporary_mesh + i, (x_end - STENCIL_RADIUS) * sizeof(*p_mesh));
+                }
+        }
+}
+
+/*
+ * The parallel 3D engines write the next mesh into the other buffer and
+ * swap, instead of copying it back; the boundary values are in both buffers.
+ */
+static void omp_stencil_3d_func(const ELEMENT_TYPE *p_src, ELEMENT_TYPE *p_dst, struct s_settings *p_settings)
+{
+        int z;
+#pragma omp parallel for schedule(static)
+        for (z = STENCIL_RADIUS; z < p_settings->mesh_depth - STENCIL_RADIUS; z++)
+        {
+                stencil_3d_block(p_src, p_dst, STENCIL_RADIUS, p_settings->mesh_width - STENCIL_RADIUS, STENCIL_RADIUS,
+                                 p_settings->mesh_height - STENCIL_RADIUS, z, p_settings);
+        }
+}
+
+/*
+ * 2.5D blocking: each plane is read by the sweeps of three planes. When
+ * three planes of the mesh do not fit in cache, a plane has been evicted
+ * before the next sweep reads it again, and each cell comes from memory
+ * three times. Each thread instead takes an x/y tile and streams it along
+ * z: the three planes of a tile, halo included, stay in cache while the
+ * next one is read, so each cell comes from memory once.
+ */
+static void blocked_stencil_3d_func(const ELEMENT_TYPE *p_src, ELEMENT_TYPE *p_dst, struct s_settings *p_settings)
+{
+        const int interior_width = p_settings->mesh_width - 2 * STENCIL_RADIUS;
+        const int interior_height = p_settings->mesh_height - 2 * STENCIL_RADIUS;
+        const int nb_tiles_x = (interior_width + p_settings->tile_width - 1) / p_settings->tile_width;
+        const int nb_tiles_y = (interior_height + p_settings->tile_height - 1) / p_settings->tile_height;
+        int tile;
+
+#pragma omp parallel for schedule(static)
+        for (tile = 0; tile < nb_tiles_x * nb_tiles_y; tile++)
+        {
+                const int x_start = STENCIL_RADIUS + (tile % nb_tiles_x) * p_settings->tile_width;
+                const int y_start = STENCIL_RADIUS + (tile / nb_tiles_x) * p_settings->tile_height;
+                const int x_end = (x_start + p_settings->tile_width < STENCIL_RADIUS + interior_width) ? x_start + p_settings->tile_width
+                                                                                                        : STENCIL_RADIUS + interior_width;
+                const int y_end = (y_start + p_settings->tile_height < STENCIL_RADIUS + interior_height) ? y_start + p_settings->tile_height
+                                                                                                          : STENCIL_RADIUS + interior_height;
+                int z;
+                for (z = STENCIL_RADIUS; z < p_settings->mesh_depth - STENCIL_RADIUS; z++)
+                {
+                        stencil_3d_block(p_src, p_dst, x_start, x_end, y_start, y_end, z, p_settings);
+                }
+        }
+}
+
+static void run_3d(ELEMENT_TYPE *p_mesh, ELEMENT_TYPE *p_temporary_mesh, struct s_phase_timer *p_timer, struct s_settings *p_settings)
+{
+        ELEMENT_TYPE *p_src = p_mesh;
+        ELEMENT_TYPE *p_dst = p_temporary_mesh;
+
+        phase_timer_begin(p_timer, phase_kernel);
+        int i;
+        for (i = 0; i < p_settings->nb_iterations; i++)
+        {
+                switch (p_settings->engine)
+                {
+                case stencil_engine_naive:
+                        naive_stencil_3d_func(p_mesh, p_temporary_mesh, p_settings);
+                        break;
+
+                case stencil_engine_omp:
+                        omp_stencil_3d_func(p_src, p_dst, p_settings);
+                        break;
+
+                case stencil_engine_blocked:
+                        blocked_stencil_3d_func(p_src, p_dst, p_settings);
+                        break;
+
+                default:
+                        PRINT_ERROR("invalid engine");
+                }
+
+                if (p_settings->engine != stencil_engine_naive)
+                {
+                        ELEMENT_TYPE *p_swap = p_src;
+                        p_src = p_dst;
+                        p_dst = p_swap;
+                }
+        }
+
+        /* after an odd number of swaps, the last sweep is in the temporary mesh */
+        if (p_src != p_mesh)
+        {
+                copy_mesh(p_mesh, p_src, p_settings);
+        }
+        phase_timer_end(p_timer, phase_kernel);
+}
+
+/* best copy bandwidth in GB/s, reads and writes counted, over nb_bytes split between source and destination */
+static double measure_peak_bandwidth(size_t nb_bytes)
+{
+        const size_t half = nb_bytes / 2;
+        char *p_src = malloc(half);
+        char *p_dst = malloc(half);
+        if (p_src == NULL || p_dst == NULL)
+        {
+                PRINT_ERROR("memory allocation failed");
+        }
+        memset(p_src, 1, half);
+        memset(p_dst, 0, half);
+
+        double best = 0.0;
+        int i;
+        for (i = 0; i < NB_BANDWIDTH_COPIES; i++)
+        {
+                struct timespec start, end;
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                memcpy(p_dst, p_src, half);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                /* reading the copy keeps it from being optimized away */
+                if (p_dst[half - 1] != p_src[half - 1])
+                {
+                        PRINT_ERROR("bandwidth copy failed");
+                }
+                const double bandwidth = 1.0e-9 * 2 * half / bench_elapsed(&start, &end);
+                if (bandwidth > best)
+                {
+                        best = bandwidth;
+                }
+        }
+
+        free(p_dst);
+        free(p_src);
+        return best;
+}
+
+static void run(ELEMENT_TYPE *p_mesh, ELEMENT_TYPE *p_temporary_mesh, struct s_active_region *p_region, struct s_multigrid *p_multigrid,
+                const struct s_variable_coefs *p_coefs, struct s_convergence *p_convergence, struct s_phase_timer *p_timer,
+                struct s_settings *p_settings)
+{
+        if (p_region != NULL)
+        {
+                reset_active_region(p_region);
+        }
+
+        ELEMENT_TYPE residual = 0;
+        int i;
+        for (i = 0; i < p_settings->nb_iterations; i++)
+        {
+                phase_timer_begin(p_timer, phase_kernel);
+                if (p_multigrid != NULL)
+                {
+                        residual = multigrid_func(p_mesh, p_multigrid, 1);
+                }
+                else if (p_coefs != NULL)
+                {
+                        residual = variable_stencil_func(p_mesh, p_temporary_mesh, p_coefs, p_settings);
+                }
+                else
+                {
+                        residual = stencil_sweep(p_mesh, p_temporary_mesh, p_region, 1, p_settings);
+                }
+                phase_timer_end(p_timer, phase_kernel);
+
+                phase_timer_begin(p_timer, phase_output);
+                if (p_settings->enable_output)
+                {
+                        char filename[32];
+                        snprintf(filename, 32, "run_mesh_%03d.csv", i);
+                        FILE *file = fopen(filename, "w");
+                        if (file == NULL)
+                        {
+                                perror("fopen");
+                                exit(EXIT_FAILURE);
                         }
                         write_mesh_to_file(file, p_mesh, p_settings);
                         fclose(file);
@@ -456,15 +2385,192 @@ static void run(ELEMENT_TYPE *p_mesh, struct s_settings *p_settings)
                         print_mesh(p_mesh, p_settings);
                         printf("\n\n");
                 }
+                phase_timer_end(p_timer, phase_output);
+
+                if (p_settings->tolerance > 0.0 && residual <= p_settings->tolerance)
+                {
+                        i++;
+                        break;
+                }
+        }
+
+        /* a cycle sweeps the fine mesh before and after the coarse correction */
+        p_convergence->nb_cycles = (p_multigrid != NULL) ? i : 0;
+        p_convergence->nb_sweeps = (p_multigrid != NULL) ? i * (MULTIGRID_PRE_SWEEPS + MULTIGRID_POST_SWEEPS) : i;
+        p_convergence->residual = residual;
+}
+
+/*
+ * Small meshes cannot keep several cores busy, so the ensemble gives whole
+ * meshes to threads instead: each thread runs every iteration of a mesh
+ * with its own temporary mesh, and takes the next mesh from a shared queue.
+ * Each mesh's time is added to mesh_times[m].
+ */
+static void run_ensemble(ELEMENT_TYPE *p_meshes, ELEMENT_TYPE *p_temporary_meshes, double *mesh_times, struct s_phase_timer *p_timer,
+                         struct s_settings *p_settings)
+{
+        const size_t size = mesh_size(p_settings);
+
+        phase_timer_begin(p_timer, phase_kernel);
+#pragma omp parallel
+        {
+                ELEMENT_TYPE *p_temporary_mesh = (p_temporary_meshes != NULL) ? p_temporary_meshes + omp_get_thread_num() * size : NULL;
+                struct s_active_region *p_region = NULL;
+                if (p_settings->engine == stencil_engine_active)
+                {
+                        init_active_region(&p_region, p_settings);
+                }
+
+                int m;
+#pragma omp for schedule(dynamic, 1)
+                for (m = 0; m < p_settings->ensemble_size; m++)
+                {
+                        struct timespec start, end;
+                        clock_gettime(CLOCK_MONOTONIC, &start);
+                        if (p_region != NULL)
+                        {
+                                reset_active_region(p_region);
+                        }
+                        int i;
+                        for (i = 0; i < p_settings->nb_iterations; i++)
+                        {
+                                stencil_sweep(p_meshes + m * size, p_temporary_mesh, p_region, 0, p_settings);
+                        }
+                        clock_gettime(CLOCK_MONOTONIC, &end);
+                        mesh_times[m] += bench_elapsed(&start, &end);
+                }
+
+                if (p_region != NULL)
+                {
+                        delete_active_region(&p_region);
+                }
+        }
+        phase_timer_end(p_timer, phase_kernel);
+}
+
+static void write_ensemble_report(const double *mesh_times, int nb_samples, struct s_settings *p_settings)
+{
+        FILE *file = fopen("ensemble_meshes.csv", "w");
+        if (file == NULL)
+        {
+                perror("fopen");
+                exit(EXIT_FAILURE);
+        }
+        int ret = fprintf(file, "mesh,initial_mesh,mean_timing,cells_per_s\n");
+        IO_CHECK("fprintf", ret);
+
+        int m;
+        for (m = 0; m < p_settings->ensemble_size; m++)
+        {
+                const char *initial_mesh = (p_settings->initial_mesh_type == initial_mesh_zero ||
+                                            (p_settings->initial_mesh_type == initial_mesh_mixed && m % 2 == 0))
+                                               ? "zero"
+                                               : "random";
+                double mean_timing = mesh_times[m] / nb_samples;
+                ret = fprintf(file, "%d,%s,%le,%le\n", m, initial_mesh, mean_timing, mesh_cell_updates(p_settings->nb_iterations, p_settings) / mean_timing);
+                IO_CHECK("fprintf", ret);
+        }
+        fclose(file);
+}
+
+/*
+ * Checks the run's final mesh against the fixed point u = S(u) rather than
+ * against a replay of the scheme. The neighbour weights of S add up to w,
+ * and after a sweep whose cells changed by at most r, S(u) - u at a cell
+ * only comes from neighbours that changed after the cell's own update:
+ * |S(u) - u| <= w * r, whichever order the sweep updated the cells in.
+ * Multigrid reports max |S(u) - u| of the fine mesh itself, which must
+ * match.
+ */
+static int check_residual(const ELEMENT_TYPE *p_mesh, ELEMENT_TYPE *p_scratch_mesh, const struct s_convergence *p_convergence,
+                          struct s_settings *p_settings)
+{
+        const int margin_x = (STENCIL_WIDTH - 1) / 2;
+        const int margin_y = (STENCIL_HEIGHT - 1) / 2;
+        const int width = p_settings->mesh_width;
+
+        copy_mesh(p_scratch_mesh, p_mesh, p_settings);
+        if (!all_boundaries_dirichlet(p_settings))
+        {
+                refresh_halo(p_scratch_mesh, p_settings);
+        }
+
+        ELEMENT_TYPE neighbour_weight = 0;
+        int tap;
+        for (tap = 0; tap < NB_TAPS; tap++)
+        {
+                if (tap != margin_y * STENCIL_WIDTH + margin_x)
+                {
+                        neighbour_weight += fabsf(stencil_coefs[tap]);
+                }
         }
+
+        ELEMENT_TYPE residual = 0;
+        ELEMENT_TYPE max_value = 0;
+        int x;
+        int y;
+        for (y = 0; y < p_settings->mesh_height; y++)
+        {
+                for (x = 0; x < width; x++)
+                {
+                        max_value = fmaxf(max_value, fabsf(p_scratch_mesh[y * width + x]));
+                        if (y >= margin_y && y < p_settings->mesh_height - margin_y && x >= margin_x && x < width - margin_x)
+                        {
+                                residual = fmaxf(residual, fabsf(stencil_cell(p_scratch_mesh, x, y, p_settings) - p_scratch_mesh[y * width + x]));
+                        }
+                }
+        }
+
+        /* rounding of the NB_TAPS products and sums of a cell */
+        const ELEMENT_TYPE rounding = NB_TAPS * FLT_EPSILON * max_value;
+        if (is_multigrid(p_settings))
+        {
+                if (fabsf(residual - p_convergence->residual) > rounding)
+                {
+                        fprintf(stderr, "check failed: residual of the final mesh = %le, reported %le\n", residual, p_convergence->residual);
+                        return 1;
+                }
+                return 0;
+        }
+
+        const ELEMENT_TYPE bound = neighbour_weight * p_convergence->residual + rounding;
+        if (residual > bound)
+        {
+                fprintf(stderr, "check failed: residual of the final mesh = %le, above %le for a last change of %le\n", residual, bound,
+                        p_convergence->residual);
+                return 1;
+        }
+        return 0;
 }
 
-static int check(const ELEMENT_TYPE *p_mesh, ELEMENT_TYPE *p_mesh_copy, struct s_settings *p_settings)
+static int check(const ELEMENT_TYPE *p_mesh, ELEMENT_TYPE *p_mesh_copy, ELEMENT_TYPE *p_temporary_mesh, struct s_multigrid *p_multigrid,
+                 const struct s_variable_coefs *p_coefs, const struct s_convergence *p_convergence, struct s_settings *p_settings)
 {
+        const int nb_iterations = (p_multigrid != NULL) ? p_convergence->nb_cycles : p_convergence->nb_sweeps;
         int i;
-        for (i = 0; i < p_settings->nb_iterations; i++)
+        for (i = 0; i < nb_iterations; i++)
         {
-                naive_stencil_func(p_mesh_copy, p_settings);
+                /* the colors are updated in the same order by one thread */
+                if (p_multigrid != NULL)
+                {
+                        multigrid_func(p_mesh_copy, p_multigrid, 0);
+                }
+                else if (p_coefs != NULL)
+                {
+                        variable_reference_func(p_mesh_copy, p_temporary_mesh, p_coefs, p_settings);
+                }
+                else if (p_settings->scheme == stencil_scheme_redblack)
+                {
+                        redblack_stencil_func(p_mesh_copy, NULL, 0, p_settings);
+                }
+                else if (is_3d(p_settings))
+                {
+                        naive_stencil_3d_func(p_mesh_copy, p_temporary_mesh, p_settings);
+                }
+                else
+                {
+                        naive_stencil_func(p_mesh_copy, p_temporary_mesh, p_settings);
+                }
 
                 if (p_settings->enable_output)
                 {
@@ -488,24 +2594,41 @@ static int check(const ELEMENT_TYPE *p_mesh, ELEMENT_TYPE *p_mesh_copy, struct s
                 }
         }
 
+        /*
+         * The active engine skips work, not arithmetic, colors do not depend on
+         * each other, and the 3D engines share the cell functions of the naive
+         * sweep: they must match exactly.
+         */
+        const ELEMENT_TYPE tolerance =
+            (p_settings->engine == stencil_engine_active || p_settings->scheme != stencil_scheme_jacobi || is_3d(p_settings)) ? 0 : EPSILON;
         int check = 0;
         int x;
         int y;
-        for (y = 0; y < p_settings->mesh_height; y++)
+        int z;
+        for (z = 0; z < p_settings->mesh_depth; z++)
         {
-                for (x = 0; x < p_settings->mesh_width; x++)
+                for (y = 0; y < p_settings->mesh_height; y++)
                 {
-                        ELEMENT_TYPE diff = fabs(p_mesh[y * p_settings->mesh_width + x] - p_mesh_copy[y * p_settings->mesh_width + x]);
-                        if (diff > EPSILON)
+                        for (x = 0; x < p_settings->mesh_width; x++)
                         {
-                                fprintf(stderr, "check failed [x: %d, y: %d]: run = %lf, check = %lf\n", x, y,
-                                        p_mesh[y * p_settings->mesh_width + x],
-                                        p_mesh_copy[y * p_settings->mesh_width + x]);
-                                check = 1;
+                                const size_t i = cell_index(x, y, z, p_settings);
+                                ELEMENT_TYPE diff = fabs(p_mesh[i] - p_mesh_copy[i]);
+                                if (diff > tolerance)
+                                {
+                                        fprintf(stderr, "check failed [x: %d, y: %d, z: %d]: run = %lf, check = %lf\n", x, y, z, p_mesh[i],
+                                                p_mesh_copy[i]);
+                                        check = 1;
+                                }
                         }
                 }
         }
 
+        /* the replay only shows the scheme is deterministic; ensembles and 3D meshes do not report a residual */
+        if (p_coefs == NULL && p_settings->ensemble_size == 1 && !is_3d(p_settings))
+        {
+                check |= check_residual(p_mesh, p_mesh_copy, p_convergence, p_settings);
+        }
+
         return check;
 }
 
@@ -516,56 +2639,242 @@ int main(int argc, char *argv[])
         init_settings(&p_settings);
         parse_cmd_line(argc, argv, p_settings);
 
+        if (p_settings->enable_pinning)
+        {
+                bench_pin_threads();
+        }
+
+        struct s_bench_samples samples;
+        bench_samples_init(&samples);
+
+        struct s_perf_counters perf_counters;
+        if (p_settings->enable_perf_counters)
+        {
+                perf_counters_init(&perf_counters);
+        }
+
+        struct s_phase_timer phase_timer;
+        phase_timer_init(&phase_timer, p_settings->enable_phase_timing, p_settings->enable_perf_counters ? &perf_counters : NULL);
+
+        phase_timer_begin(&phase_timer, phase_alloc);
+        const int ensemble_size = p_settings->ensemble_size;
+        const size_t size = mesh_size(p_settings);
+
         ELEMENT_TYPE *p_mesh = NULL;
-        allocate_mesh(&p_mesh, p_settings);
+        allocate_mesh(&p_mesh, ensemble_size, p_settings);
 
         ELEMENT_TYPE *p_mesh_copy = NULL;
-        allocate_mesh(&p_mesh_copy, p_settings);
+        allocate_mesh(&p_mesh_copy, ensemble_size, p_settings);
+
+        /* an ensemble needs one temporary mesh per thread, the in-place schemes none */
+        ELEMENT_TYPE *p_temporary_mesh = NULL;
+        if (p_settings->scheme == stencil_scheme_jacobi)
+        {
+                allocate_mesh(&p_temporary_mesh, (ensemble_size > 1) ? omp_get_max_threads() : 1, p_settings);
+        }
+
+        double *mesh_times = NULL;
+        if (ensemble_size > 1)
+        {
+                mesh_times = calloc(ensemble_size, sizeof(*mesh_times));
+                if (mesh_times == NULL)
+                {
+                        PRINT_ERROR("memory allocation failed");
+                }
+        }
+
+        struct s_active_region *p_region = NULL;
+        if (p_settings->engine == stencil_engine_active)
+        {
+                init_active_region(&p_region, p_settings);
+        }
+
+        struct s_multigrid *p_multigrid = NULL;
+        if (is_multigrid(p_settings))
+        {
+                init_multigrid(&p_multigrid, p_settings);
+        }
+
+        struct s_variable_coefs *p_coefs = NULL;
+        if (p_settings->coef_layout != coef_layout_constant)
+        {
+                init_variable_coefs(&p_coefs, p_settings);
+        }
+        phase_timer_end(&phase_timer, phase_alloc);
+
+        double peak_bandwidth = 0.0;
+        if (p_settings->enable_bandwidth_report)
+        {
+                peak_bandwidth = measure_peak_bandwidth(variable_coefs_footprint(p_coefs, p_settings));
+        }
 
         {
                 if (!p_settings->enable_verbose)
                 {
-                        print_csv_header();
+                        if (p_settings->enable_summary)
+                        {
+                                print_summary_csv_header(p_settings);
+                        }
+                        else
+                        {
+                                print_csv_header(p_settings);
+                        }
                 }
 
-                int rep;
-                for (rep = 0; rep < p_settings->nb_repeat; rep++)
+                double measured_time = 0.0;
+                int summary_check_status = 0;
+                struct s_convergence convergence = {p_settings->nb_iterations, 0, 0};
+                int iter;
+                for (iter = 0; iter < p_settings->nb_warmup + p_settings->nb_repeat || measured_time < p_settings->min_time; iter++)
                 {
+                        const int is_warmup = iter < p_settings->nb_warmup;
+                        const int rep = iter - p_settings->nb_warmup;
+
                         if (p_settings->enable_verbose)
                         {
-                                printf("repeat %d\n", rep);
+                                if (is_warmup)
+                                {
+                                        printf("warmup %d\n", iter);
+                                }
+                                else
+                                {
+                                        printf("repeat %d\n", rep);
+                                }
                         }
 
-                        init_mesh_values(p_mesh, p_settings);
-                        apply_boundary_conditions(p_mesh, p_settings);
-                        copy_mesh(p_mesh_copy, p_mesh, p_settings);
+                        phase_timer_reset(&phase_timer);
+
+                        phase_timer_begin(&phase_timer, phase_init);
+                        int m;
+                        for (m = 0; m < ensemble_size; m++)
+                        {
+                                init_mesh_values(p_mesh + m * size, m, p_settings);
+                                apply_boundary_conditions(p_mesh + m * size, p_settings);
+                                copy_mesh(p_mesh_copy + m * size, p_mesh + m * size, p_settings);
+                        }
+                        /* the swapping 3D engines read the boundaries from both buffers */
+                        if (is_3d(p_settings))
+                        {
+                                apply_boundary_conditions(p_temporary_mesh, p_settings);
+                        }
+                        phase_timer_end(&phase_timer, phase_init);
 
+                        phase_timer_begin(&phase_timer, phase_output);
                         if (p_settings->enable_verbose)
                         {
                                 printf("initial mesh\n");
                                 print_mesh(p_mesh, p_settings);
                                 printf("\n\n");
                         }
+                        phase_timer_end(&phase_timer, phase_output);
+
+                        if (ensemble_size > 1)
+                        {
+                                run_ensemble(p_mesh, p_temporary_mesh, mesh_times, &phase_timer, p_settings);
+                                /* per-mesh times only cover the measured repeats */
+                                if (is_warmup)
+                                {
+                                        memset(mesh_times, 0, ensemble_size * sizeof(*mesh_times));
+                                }
+                        }
+                        else if (is_3d(p_settings))
+                        {
+                                run_3d(p_mesh, p_temporary_mesh, &phase_timer, p_settings);
+                        }
+                        else
+                        {
+                                run(p_mesh, p_temporary_mesh, p_region, p_multigrid, p_coefs, &convergence, &phase_timer, p_settings);
+                        }
+                        double timing_in_seconds = phase_timer.elapsed[phase_kernel];
+
+                        if (is_warmup)
+                        {
+                                continue;
+                        }
+
+                        bench_samples_add(&samples, timing_in_seconds);
+                        measured_time += timing_in_seconds;
+
+                        phase_timer_begin(&phase_timer, phase_check);
+                        int check_status = 0;
+                        for (m = 0; m < ensemble_size; m++)
+                        {
+                                check_status |= check(p_mesh + m * size, p_mesh_copy + m * size, p_temporary_mesh, p_multigrid, p_coefs, &convergence, p_settings);
+                        }
+                        phase_timer_end(&phase_timer, phase_check);
 
-                        struct timespec timing_start, timing_end;
-                        clock_gettime(CLOCK_MONOTONIC, &timing_start);
-                        run(p_mesh, p_settings);
-                        clock_gettime(CLOCK_MONOTONIC, &timing_end);
-                        double timing_in_seconds = (timing_end.tv_sec - timing_start.tv_sec) + 1.0e-9 * (timing_end.tv_nsec - timing_start.tv_nsec);
+                        phase_timer_collect(&phase_timer);
 
-                        int check_status = check(p_mesh, p_mesh_copy, p_settings);
+                        if (p_settings->enable_summary)
+                        {
+                                summary_check_status |= check_status;
+                                continue;
+                        }
 
                         if (p_settings->enable_verbose)
                         {
-                                print_csv_header();
+                                print_csv_header(p_settings);
                         }
                         print_settings_csv(p_settings);
                         printf(",");
                         print_results_csv(rep, timing_in_seconds, check_status);
+                        print_convergence_csv(&convergence, p_settings);
+                        print_bandwidth_csv(mesh_cell_updates(convergence.nb_sweeps, p_settings) * ensemble_size, timing_in_seconds, peak_bandwidth,
+                                            p_settings);
+                        if (p_settings->enable_phase_timing)
+                        {
+                                printf(",");
+                                phase_timer_print_csv(&phase_timer);
+                        }
+                        if (p_settings->enable_perf_counters)
+                        {
+                                printf(",");
+                                perf_counters_print_last_csv(&perf_counters);
+                        }
                         printf("\n");
                 }
+
+                if (p_settings->enable_summary)
+                {
+                        if (p_settings->enable_verbose)
+                        {
+                                print_summary_csv_header(p_settings);
+                        }
+                        print_summary_csv(&samples, summary_check_status, &convergence, peak_bandwidth, &phase_timer, p_settings);
+                }
+        }
+
+        if (p_region != NULL)
+        {
+                delete_active_region(&p_region);
+        }
+
+        if (p_multigrid != NULL)
+        {
+                delete_multigrid(&p_multigrid);
+        }
+
+        if (p_coefs != NULL)
+        {
+                delete_variable_coefs(&p_coefs);
         }
 
+        if (ensemble_size > 1)
+        {
+                write_ensemble_report(mesh_times, samples.nb_values, p_settings);
+                free(mesh_times);
+        }
+
+        if (p_settings->enable_perf_counters)
+        {
+                perf_counters_delete(&perf_counters);
+        }
+        bench_samples_delete(&samples);
+
+        if (p_temporary_mesh != NULL)
+        {
+                delete_mesh(&p_temporary_mesh);
+        }
         delete_mesh(&p_mesh_copy);
         delete_mesh(&p_mesh);
         delete_settings(&p_settings);